@@ -0,0 +1,194 @@
+#include "search-strategies.h"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+
+namespace {
+
+struct AnytimeNode {
+	const SearchState *state;
+	size_t parent;
+	std::optional<SearchAction> action;
+	int g;
+	double h;
+	bool open;
+};
+
+struct OpenEntry {
+	double f;
+	int g;
+	size_t node;
+};
+
+// lowest f first, deeper first among equal f, then older first
+struct OpenEntryWorse {
+	bool operator()(const OpenEntry &a, const OpenEntry &b) const {
+		if (a.f != b.f)
+			return a.f > b.f;
+		if (a.g != b.g)
+			return a.g < b.g;
+		return a.node > b.node;
+	}
+};
+
+} // namespace
+
+std::vector<SearchAction> AnytimeAStarSearch::solve(const SearchState &init_state) {
+	auto t_start = std::chrono::steady_clock::now();
+	auto out_of_time = [&]() {
+		return time_limit_.count() > 0 && std::chrono::steady_clock::now() - t_start > time_limit_;
+	};
+
+	if (init_state.isFinal())
+		return {};
+
+	std::unordered_map<SearchState, size_t> index;
+	std::vector<AnytimeNode> nodes;
+	double weight = std::max(1.0, initial_weight_);
+
+	using OpenList = std::priority_queue<OpenEntry, std::vector<OpenEntry>, OpenEntryWorse>;
+	OpenList open;
+
+	auto push = [&](size_t node_id) {
+		const auto &node = nodes[node_id];
+		open.push({node.g + weight * node.h, node.g, node_id});
+	};
+
+	auto add_node = [&](SearchState &&state, size_t parent, std::optional<SearchAction> action, int g, double h) {
+		auto [it, inserted] = index.emplace(std::move(state), nodes.size());
+		(void) inserted;
+		nodes.push_back({&it->first, parent, action, g, h, true});
+		push(nodes.size() - 1);
+	};
+
+	add_node(SearchState(init_state), 0, std::nullopt, 0, compute_heuristic(init_state, *heuristic_));
+
+	std::vector<SearchAction> best_solution;
+	int best_length = std::numeric_limits<int>::max();
+
+	auto record_solution = [&](size_t parent, const SearchAction &last_action, int length) {
+		best_length = length;
+		best_solution = {last_action};
+		for (size_t node_id = parent; nodes[node_id].action.has_value(); node_id = nodes[node_id].parent)
+			best_solution.push_back(*nodes[node_id].action);
+		std::reverse(best_solution.begin(), best_solution.end());
+		publishSolution(best_solution);
+	};
+
+	auto lower_weight = [&]() {
+		if (weight <= 1.0)
+			return;
+		weight = std::max(1.0, weight - weight_step_);
+
+		// re-key whatever is open under the new weight
+		OpenList rekeyed;
+		for (size_t node_id = 0; node_id < nodes.size(); ++node_id) {
+			const auto &node = nodes[node_id];
+			if (node.open && node.g + node.h < best_length)
+				rekeyed.push({node.g + weight * node.h, node.g, node_id});
+		}
+		open = std::move(rekeyed);
+	};
+
+	// successors seen for the first time, scored together
+	std::vector<SearchState> fresh;
+	std::vector<SearchAction> fresh_actions;
+	std::vector<const SearchState *> fresh_ptrs;
+	std::vector<double> fresh_bounds;
+	const bool incremental = heuristic_->isIncremental();
+	MoveTrail trail;
+	ActionList parent_actions;
+
+	size_t nb_expansions = 0;
+	while (!open.empty()) {
+		if (++nb_expansions % 256 == 0 && out_of_time())
+			break;
+
+		OpenEntry entry = open.top();
+		open.pop();
+
+		auto &node = nodes[entry.node];
+		// stale entry of a node reopened with a better g or already expanded
+		if (!node.open || node.g != entry.g)
+			continue;
+		node.open = false;
+
+		if (node.g + node.h >= best_length)
+			continue;
+
+		size_t parent_id = entry.node;
+		int child_g = node.g + 1;
+		const SearchState &parent_state = *node.state;
+		double parent_h = node.h;
+		bool improved = false;
+		fresh.clear();
+		fresh_actions.clear();
+		fresh_bounds.clear();
+
+		parent_state.actions(parent_actions);
+		for (const auto &action : parent_actions) {
+			SearchState child = incremental ? action.execute(parent_state, trail) : action.execute(parent_state);
+
+			if (child.isFinal()) {
+				int length = child_g + child.distanceLeft();
+				if (length < best_length) {
+					record_solution(parent_id, action, length);
+					improved = true;
+				}
+				continue;
+			}
+
+			auto it = index.find(child);
+			if (it == index.end()) {
+				if (incremental)
+					fresh_bounds.push_back(compute_heuristic_after(parent_h, child, trail, *heuristic_));
+				fresh.push_back(std::move(child));
+				fresh_actions.push_back(action);
+			} else {
+				size_t known_id = it->second;
+				auto &known = nodes[known_id];
+				if (child_g >= known.g)
+					continue;
+				known.g = child_g;
+				known.parent = parent_id;
+				known.action = action;
+				known.open = true;
+				// the stored state also keeps the action which led to it, which
+				// ImmediateUndo prunes the way back by: it has to be the new one.
+				// The key is swapped in place, so known.state keeps pointing at it.
+				auto handle = index.extract(it);
+				handle.key() = std::move(child);
+				index.insert(std::move(handle));
+				push(known_id);
+			}
+		}
+
+		if (!incremental && !best_solution.empty()) {
+			// nodes which can not beat the best solution are pruned anyway,
+			// so their evaluation may stop once it shows that
+			fresh_bounds.resize(fresh.size());
+			for (size_t i = 0; i < fresh.size(); ++i)
+				fresh_bounds[i] = compute_heuristic_cutoff(fresh[i], best_length - child_g, *heuristic_);
+		} else if (!incremental) {
+			fresh_ptrs.clear();
+			for (const auto &state : fresh)
+				fresh_ptrs.push_back(&state);
+			fresh_bounds.resize(fresh.size());
+			compute_heuristics(fresh_ptrs.data(), fresh_ptrs.size(), *heuristic_, fresh_bounds.data());
+		}
+
+		for (size_t i = 0; i < fresh.size(); ++i) {
+			// the same state may have been generated twice from this node
+			if (index.count(fresh[i]) == 0)
+				add_node(std::move(fresh[i]), parent_id, fresh_actions[i], child_g, fresh_bounds[i]);
+		}
+
+		if (improved)
+			lower_weight();
+	}
+
+	return best_solution;
+}
@@ -0,0 +1,111 @@
+#include "search-strategies.h"
+
+#include <algorithm>
+#include <optional>
+#include <unordered_set>
+
+namespace {
+
+struct BeamNode {
+	SearchState state;
+	size_t parent;
+	std::optional<SearchAction> action;
+	double h;
+};
+
+struct BeamCandidate {
+	SearchState state;
+	size_t parent;
+	SearchAction action;
+	double h;
+};
+
+struct BeamLink {
+	size_t parent;
+	SearchAction action;
+};
+
+} // namespace
+
+std::vector<SearchAction> BeamSearch::solve(const SearchState &init_state) {
+	if (init_state.isFinal())
+		return {};
+
+	std::unordered_set<SearchState> kept{init_state};
+	const bool incremental = heuristic_->isIncremental();
+	std::vector<BeamNode> layer{{init_state, 0, std::nullopt, incremental ? compute_heuristic(init_state, *heuristic_) : 0.0}};
+	MoveTrail trail;
+	ActionList actions;
+	// how each node of each layer was reached, layer 0 is the initial state
+	std::vector<std::vector<BeamLink>> history;
+
+	auto reconstruct = [&](size_t parent, const SearchAction &last_action) {
+		std::vector<SearchAction> solution{last_action};
+		for (size_t depth = history.size(); depth > 0; --depth) {
+			const auto &link = history[depth - 1][parent];
+			solution.push_back(link.action);
+			parent = link.parent;
+		}
+		std::reverse(solution.begin(), solution.end());
+		return solution;
+	};
+
+	for (size_t depth = 0; depth < max_depth_; ++depth) {
+		std::vector<BeamCandidate> candidates;
+		std::unordered_set<SearchState> in_layer;
+
+		for (size_t i = 0; i < layer.size(); ++i) {
+			layer[i].state.actions(actions);
+			for (const auto &action : actions) {
+				SearchState child = incremental ? action.execute(layer[i].state, trail) : action.execute(layer[i].state);
+				if (child.isFinal())
+					return reconstruct(i, action);
+
+				if (kept.count(child) > 0 || !in_layer.insert(child).second)
+					continue;
+
+				double h = incremental ? compute_heuristic_after(layer[i].h, child, trail, *heuristic_) : 0.0;
+				candidates.push_back({std::move(child), i, action, h});
+			}
+		}
+
+		if (candidates.empty())
+			return {};
+
+		if (!incremental) {
+			std::vector<const SearchState *> candidate_ptrs;
+			std::vector<double> bounds(candidates.size());
+			candidate_ptrs.reserve(candidates.size());
+			for (const auto &candidate : candidates)
+				candidate_ptrs.push_back(&candidate.state);
+			compute_heuristics(candidate_ptrs.data(), candidate_ptrs.size(), *heuristic_, bounds.data());
+			for (size_t i = 0; i < candidates.size(); ++i)
+				candidates[i].h = bounds[i];
+		}
+
+		if (candidates.size() > beam_width_) {
+			// ties are broken by generation order to keep runs repeatable
+			std::stable_sort(
+				candidates.begin(),
+				candidates.end(),
+				[](const BeamCandidate &a, const BeamCandidate &b){return a.h < b.h;}
+			);
+			candidates.erase(candidates.begin() + beam_width_, candidates.end());
+		}
+
+		std::vector<BeamNode> next_layer;
+		std::vector<BeamLink> links;
+		next_layer.reserve(candidates.size());
+		links.reserve(candidates.size());
+		for (auto &candidate : candidates) {
+			kept.insert(candidate.state);
+			links.push_back({candidate.parent, candidate.action});
+			next_layer.push_back({std::move(candidate.state), candidate.parent, candidate.action, candidate.h});
+		}
+
+		history.push_back(std::move(links));
+		layer = std::move(next_layer);
+	}
+
+	return {};
+}
@@ -0,0 +1,154 @@
+#include "search-strategies.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+struct ForwardNode {
+	SearchState state;
+	size_t parent;
+	// the action from the parent, none for the root
+	SearchAction action;
+	int depth;
+};
+
+struct BackwardNode {
+	GameState state;
+	// canonicalKey() of the state one action closer to the solved one,
+	// reached by an action of nb_cards cards
+	std::string next;
+	size_t nb_cards;
+	int depth;
+};
+
+GameState solvedState() {
+	GameState solved;
+	for (size_t i = 0; i < colors_list.size(); ++i) {
+		for (int j = 1; j <= king_value; ++j)
+			solved.homes[i].acceptCard({colors_list[i], j});
+	}
+	return solved;
+}
+
+} // namespace
+
+std::vector<SearchAction> BidirectionalSearch::solve(const SearchState &init_state) {
+	if (init_state.isFinal())
+		return {};
+
+	// a deque, so that the nodes stay in place while their children are added
+	std::deque<ForwardNode> forward{{init_state, 0, SearchAction(Location{}, Location{}), 0}};
+	std::unordered_map<std::string, size_t> forward_seen{{canonicalKey(init_state.gameState()), 0}};
+	size_t forward_layer = 0;
+	int forward_depth = 0;
+
+	const std::string goal_key = canonicalKey(solvedState());
+	std::unordered_map<std::string, BackwardNode> backward{{goal_key, {solvedState(), {}, 0, 0}}};
+	std::vector<std::string> backward_layer{goal_key};
+	std::vector<std::string> next_backward_layer;
+	int backward_depth = 0;
+
+	auto path_to = [&](size_t node_id) {
+		std::vector<SearchAction> solution;
+		for (size_t i = node_id; i != 0; i = forward[i].parent)
+			solution.push_back(forward[i].action);
+		std::reverse(solution.begin(), solution.end());
+		return solution;
+	};
+
+	// the path to the forward node, then the backward half replayed from there
+	auto splice = [&](size_t node_id, std::string key) {
+		auto solution = path_to(node_id);
+		SearchState current = forward[node_id].state;
+		while (key != goal_key) {
+			const auto &node = backward.at(key);
+			auto action = actionLeadingTo(current, node.next, node.nb_cards);
+			assert(action.has_value());
+			solution.push_back(*action);
+			current = action->execute(current);
+			key = node.next;
+		}
+		return solution;
+	};
+
+	// with an endgame database, final states may still be some actions away
+	// from the win, so the best solution is kept until no shorter one is left
+	std::vector<SearchAction> best_solution;
+	int best_length = std::numeric_limits<int>::max();
+	auto meet = [&](size_t node_id, const std::string &key) {
+		int length = forward[node_id].depth + backward.at(key).depth;
+		if (length < best_length) {
+			best_length = length;
+			best_solution = splice(node_id, key);
+		}
+	};
+
+	ActionList actions;
+	while (forward.size() + backward.size() < max_states_) {
+		// every path up to forward_depth + backward_depth actions long shares a state
+		// between the halves, so nothing shorter than the best one is left
+		if (best_length <= forward_depth + backward_depth + 1)
+			return best_solution;
+
+		size_t forward_frontier = forward.size() - forward_layer;
+		if (forward_frontier == 0 && backward_layer.empty())
+			break;
+
+		if (forward_frontier > 0 && (backward_layer.empty() || forward_frontier <= backward_layer.size())) {
+			size_t layer_end = forward.size();
+			for (size_t next = forward_layer; next < layer_end && forward.size() + backward.size() < max_states_; ++next) {
+				// copied, as the children go into the same deque
+				const SearchState current = forward[next].state;
+				current.actions(actions);
+				for (const auto &action : actions) {
+					SearchState child = action.execute(current);
+					if (child.isFinal() && !child.isWon()) {
+						int length = forward_depth + 1 + child.distanceLeft();
+						if (length < best_length) {
+							best_length = length;
+							best_solution = path_to(next);
+							best_solution.push_back(action);
+						}
+						continue;
+					}
+
+					auto key = canonicalKey(child.gameState());
+					if (!forward_seen.emplace(key, forward.size()).second)
+						continue;
+					forward.push_back({std::move(child), next, action, forward_depth + 1});
+					if (backward.count(key))
+						meet(forward.size() - 1, key);
+				}
+			}
+			forward_layer = layer_end;
+			forward_depth++;
+		} else {
+			next_backward_layer.clear();
+			for (const auto &key : backward_layer) {
+				// copied, as the predecessors go into the same table
+				const BackwardNode node = backward.at(key);
+				for (auto &predecessor : settledPredecessors(SearchState(node.state), max_taken_)) {
+					auto predecessor_key = canonicalKey(predecessor.state);
+					BackwardNode entry{std::move(predecessor.state), key, predecessor.action.nbCards(), node.depth + 1};
+					if (!backward.emplace(predecessor_key, std::move(entry)).second)
+						continue;
+					next_backward_layer.push_back(predecessor_key);
+
+					auto it = forward_seen.find(predecessor_key);
+					if (it != forward_seen.end())
+						meet(it->second, predecessor_key);
+				}
+				if (forward.size() + backward.size() >= max_states_)
+					break;
+			}
+			backward_layer.swap(next_backward_layer);
+			backward_depth++;
+		}
+	}
+
+	return best_solution;
+}
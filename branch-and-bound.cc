@@ -0,0 +1,152 @@
+#include "search-strategies.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+struct BnbChild {
+	double h;
+	SearchAction action;
+};
+
+struct BnbFrame {
+	SearchState state;
+	// ordered by h, the ones already cut left out
+	std::vector<BnbChild> children;
+	size_t next;
+};
+
+} // namespace
+
+void DepthFirstBranchAndBound::setUpperBound(size_t length, std::vector<SearchAction> solution) {
+	assert(solution.empty() || solution.size() == length);
+	upper_bound_ = length;
+	incumbent_ = std::move(solution);
+}
+
+std::vector<SearchAction> DepthFirstBranchAndBound::solve(const SearchState &init_state) {
+	auto t_start = std::chrono::steady_clock::now();
+	auto out_of_time = [&]() {
+		return time_limit_.count() > 0 && std::chrono::steady_clock::now() - t_start > time_limit_;
+	};
+
+	size_t best_length = upper_bound_.value_or(std::numeric_limits<size_t>::max());
+	std::vector<SearchAction> best_solution = std::move(incumbent_);
+	upper_bound_.reset();
+	incumbent_.clear();
+
+	if (init_state.isFinal())
+		return {};
+
+	if (initial_) {
+		// completed, so that its length counts the actions an endgame database leaves
+		auto initial = completeSolution(init_state, initial_->solve(init_state));
+		if (!initial.empty() && initial.size() < best_length) {
+			best_length = initial.size();
+			best_solution = std::move(initial);
+			publishSolution(best_solution);
+		}
+	}
+
+	std::vector<BnbFrame> path;
+	std::vector<SearchAction> path_actions;
+	std::unordered_set<SearchState> on_path;
+	std::unordered_map<SearchState, size_t> transpositions;
+	const bool incremental = heuristic_->isIncremental();
+	MoveTrail trail;
+	ActionList actions;
+
+	// whether a state reached in g moves is worth a visit, remembering it if so
+	auto visit = [&](const SearchState &state, size_t g) {
+		if (tt_size_ == 0)
+			return true;
+		auto it = transpositions.find(state);
+		if (it != transpositions.end()) {
+			if (it->second <= g)
+				return false;
+			it->second = g;
+		} else if (transpositions.size() < tt_size_) {
+			transpositions.emplace(state, g);
+		}
+		return true;
+	};
+
+	// the frame of a state reached in g moves, valued h
+	auto make_frame = [&](SearchState &&state, size_t g, double h) {
+		BnbFrame frame{std::move(state), {}, 0};
+		if (g + 1 >= best_length || g + 1 > max_depth_)
+			return frame;
+
+		frame.state.actions(actions);
+		for (const auto &action : actions) {
+			SearchState child = incremental ? action.execute(frame.state, trail) : action.execute(frame.state);
+
+			if (child.isFinal()) {
+				size_t length = g + 1 + child.distanceLeft();
+				if (length < best_length) {
+					best_length = length;
+					best_solution = path_actions;
+					best_solution.push_back(action);
+					publishSolution(best_solution);
+				}
+				continue;
+			}
+
+			if (on_path.count(child) > 0)
+				continue;
+
+			double child_h;
+			if (incremental)
+				child_h = compute_heuristic_after(h, child, trail, *heuristic_);
+			else if (best_length != std::numeric_limits<size_t>::max())
+				child_h = compute_heuristic_cutoff(child, best_length - (g + 1), *heuristic_);
+			else
+				child_h = compute_heuristic(child, *heuristic_);
+
+			if (g + 1 + child_h < best_length)
+				frame.children.push_back({child_h, action});
+		}
+
+		std::stable_sort(frame.children.begin(), frame.children.end(),
+			[](const BnbChild &a, const BnbChild &b){return a.h < b.h;});
+		return frame;
+	};
+
+	visit(init_state, 0);
+	on_path.insert(init_state);
+	path.push_back(make_frame(SearchState(init_state), 0, compute_heuristic(init_state, *heuristic_)));
+
+	size_t nb_steps = 0;
+	while (!path.empty()) {
+		if (++nb_steps % 256 == 0 && out_of_time())
+			break;
+
+		auto &frame = path.back();
+		size_t g = path.size() - 1;
+
+		// the children are ordered by h, so once one is cut by the best solution
+		// (which may have improved since the frame was made) so are the rest
+		if (frame.next == frame.children.size() || g + 1 + frame.children[frame.next].h >= best_length) {
+			on_path.erase(frame.state);
+			path.pop_back();
+			if (!path_actions.empty())
+				path_actions.pop_back();
+			continue;
+		}
+
+		const auto child_info = frame.children[frame.next++];
+		SearchState child = incremental ? child_info.action.execute(frame.state, trail) : child_info.action.execute(frame.state);
+		if (!visit(child, g + 1))
+			continue;
+
+		on_path.insert(child);
+		path_actions.push_back(child_info.action);
+		path.push_back(make_frame(std::move(child), g + 1, child_info.h));
+	}
+
+	return best_solution;
+}
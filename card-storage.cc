@@ -21,10 +21,48 @@ bool HomeDestination::canAccept(const Card & card) const {
 		return canSitOn(*topCard(), card);
 }
 
+void CardIndex::clear() {
+    top.fill(nowhere);
+    slot.fill(nowhere);
+    depth.fill(0);
+    home_value.fill(0);
+    home_slot.fill(-1);
+}
+
+void CardIndex::place(const Card &card, std::uint8_t card_slot, std::size_t card_depth) {
+    slot[id(card)] = card_slot;
+    depth[id(card)] = card_depth;
+    top[card_slot] = id(card);
+}
+
+void CardIndex::take(const Card &card, const std::optional<Card> &new_top) {
+    top[slot[id(card)]] = new_top.has_value() ? id(*new_top) : nowhere;
+    slot[id(card)] = nowhere;
+}
+
+void CardIndex::placeHome(const Card &card, std::uint8_t card_slot) {
+    place(card, card_slot, card.value - 1);
+    home_value[static_cast<int>(card.color)] = card.value;
+    home_slot[static_cast<int>(card.color)] = card_slot;
+}
+
+void CardIndex::takeHome(const Card &card) {
+    if (card.value > 1)
+        take(card, Card{card.color, card.value - 1});
+    else
+        take(card, std::nullopt);
+    home_value[static_cast<int>(card.color)] = card.value - 1;
+    if (card.value == 1)
+        home_slot[static_cast<int>(card.color)] = -1;
+}
+
 bool HomeDestination::acceptCard(const Card & card) {
 	auto move_ok = canAccept(card);
-	if (move_ok) 
+	if (move_ok) {
 		storage_.push_back(card);
+		if (index_)
+			index_->placeHome(card, slot_);
+	}
 
 	return move_ok;
 }
@@ -56,6 +94,8 @@ bool operator== (const WorkStack &lhs, const WorkStack &rhs) {
 std::optional<Card> HomeDestination::getCard() {
 	auto card = storage_.back();
 	storage_.pop_back();
+	if (index_)
+		index_->takeHome(card);
 	return card;
 }
 
@@ -75,13 +115,16 @@ bool FreeCell::canAccept([[maybe_unused]] const Card & card) const {
 
 bool FreeCell::acceptCard(const Card & card) {
 	auto move_ok = canAccept(card);
-    if (move_ok)
+    if (move_ok) {
         cell_.emplace(card);
+        if (index_)
+            index_->place(card, slot_, 0);
+    }
 
     return move_ok;
 }
 
-FreeCell & FreeCell::operator=(FreeCell &other) {
+FreeCell & FreeCell::operator=(const FreeCell &other) {
 	if (other.cell_.has_value())
 		cell_.emplace(*other.cell_);
 	else
@@ -97,6 +140,8 @@ const std::optional<Card> FreeCell::topCard() const {
 std::optional<Card> FreeCell::getCard() {
 	auto card = std::move(cell_);
 	cell_.reset();
+	if (index_ && card.has_value())
+		index_->take(*card, std::nullopt);
 	return card;
 }
 
@@ -136,7 +181,7 @@ bool WorkStack::canAccept(const Card & card) const {
 bool WorkStack::acceptCard(const Card & card) {
 	auto move_ok = canAccept(card);
 	if (move_ok) 
-		storage_.push_back(card);
+		forceCard(card);
 
 	return move_ok;
 }
@@ -153,6 +198,8 @@ std::optional<Card> WorkStack::getCard() {
 	if (storage_.size() > 0) {
         auto card = storage_.back();
         storage_.pop_back();
+		if (index_)
+			index_->take(card, topCard());
 		return card;
 	} else {
 		return std::nullopt;
@@ -161,6 +208,8 @@ std::optional<Card> WorkStack::getCard() {
 
 void WorkStack::forceCard(const Card & card) {
 	storage_.push_back(card);
+	if (index_)
+		index_->place(card, slot_, storage_.size() - 1);
 }
 
 std::ostream& operator<< (std::ostream& os, const WorkStack & stack) {
@@ -3,11 +3,38 @@
 
 #include "card.h"
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <optional>
 
 
+// Where each card of a game is: the slot of its storage (in GameState::all_storage
+// order) and its depth from the bottom of it, plus the top value home for each
+// color. Storages attached to an index keep it up to date on every change.
+struct CardIndex {
+    static constexpr std::uint8_t nowhere = 0xff;
+    static constexpr int nb_cards = 4 * king_value;
+    static int id(const Card &card) {return static_cast<int>(card.color) * king_value + card.value - 1;}
+
+    CardIndex() {clear();}
+    void clear();
+
+    void place(const Card &card, std::uint8_t slot, std::size_t depth);
+    void take(const Card &card, const std::optional<Card> &new_top);
+    void placeHome(const Card &card, std::uint8_t slot);
+    void takeHome(const Card &card);
+
+    static constexpr int nb_slots = 16;
+    std::array<std::uint8_t, nb_slots> top; // card id on top of each slot, or nowhere
+    std::array<std::uint8_t, nb_cards> slot;
+    std::array<std::uint8_t, nb_cards> depth;
+    std::array<int, 4> home_value; // by color
+    std::array<int, 4> home_slot; // by color, -1 until its ace is home
+};
+
+
 class CardStorage {
 public:
 	virtual bool canAccept(const Card & card) const = 0;
@@ -15,6 +42,18 @@ public:
     virtual const std::optional<Card> topCard() const = 0;
     virtual std::optional<Card> getCard() = 0;
 	virtual ~CardStorage() {};
+
+	// reports every card entering or leaving this storage to `index` under `slot`
+	void attachIndex(CardIndex *index, std::uint8_t slot) {index_ = index; slot_ = slot;}
+
+protected:
+	CardStorage() = default;
+	// copies are left unattached, the owner attaches them
+	CardStorage(const CardStorage &) {}
+	CardStorage & operator=(const CardStorage &) {return *this;}
+
+	CardIndex *index_ = nullptr;
+	std::uint8_t slot_ = 0;
 };
 
 
@@ -67,7 +106,9 @@ bool operator== (const WorkStack &lhs, const WorkStack &rhs) ;
 
 class FreeCell : public CardStorage {
 public:
-	FreeCell & operator=(FreeCell &other) ;
+	FreeCell() = default;
+	FreeCell(const FreeCell &other) = default;
+	FreeCell & operator=(const FreeCell &other) ;
 
 	bool canAccept(const Card & card) const override;
     bool acceptCard(const Card & card) override;
@@ -0,0 +1,235 @@
+#include "deal-corpus.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr char corpus_magic[8] = {'F', 'C', 'D', 'E', 'A', 'L', '0', '1'};
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t deal_size;
+    std::uint32_t reserved;
+    std::uint64_t nb_deals;
+    std::uint64_t checksum;
+};
+
+// bits used for the number of cards of each storage, in all_storage order
+constexpr int cell_bits = 1;
+constexpr int stack_bits = 6;
+constexpr int home_bits = 4;
+constexpr int nb_storages = nb_freecells + nb_stacks + nb_homes;
+
+int sizeBits(int slot) {
+    if (slot < nb_freecells)
+        return cell_bits;
+    else if (slot < nb_freecells + nb_stacks)
+        return stack_bits;
+    else
+        return home_bits;
+}
+
+// the two high bits of every byte, read as one little-endian bit string
+class SizeBitsWriter {
+public:
+    explicit SizeBitsWriter(std::uint8_t *bytes) : bytes_(bytes) {}
+
+    void write(int value, int nb_bits) {
+        for (int i = 0; i < nb_bits; ++i, ++pos_) {
+            if (value & (1 << i))
+                bytes_[pos_ / 2] |= 1 << (6 + pos_ % 2);
+        }
+    }
+
+private:
+    std::uint8_t *bytes_;
+    int pos_ = 0;
+};
+
+class SizeBitsReader {
+public:
+    explicit SizeBitsReader(const std::uint8_t *bytes) : bytes_(bytes) {}
+
+    int read(int nb_bits) {
+        int value = 0;
+        for (int i = 0; i < nb_bits; ++i, ++pos_) {
+            if (bytes_[pos_ / 2] & (1 << (6 + pos_ % 2)))
+                value |= 1 << i;
+        }
+        return value;
+    }
+
+private:
+    const std::uint8_t *bytes_;
+    int pos_ = 0;
+};
+
+constexpr std::uint8_t card_mask = 0x3f;
+
+std::uint8_t cardId(const Card &card) {
+    return CardIndex::id(card);
+}
+
+Card cardFromId(std::uint8_t id) {
+    return {static_cast<Color>(id / king_value), id % king_value + 1};
+}
+
+// FNV-1a
+class Checksum {
+public:
+    void add(const std::uint8_t *bytes, std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            hash_ ^= bytes[i];
+            hash_ *= 0x100000001b3ULL;
+        }
+    }
+
+    std::uint64_t value() const {return hash_;}
+
+private:
+    std::uint64_t hash_ = 0xcbf29ce484222325ULL;
+};
+
+} // namespace
+
+EncodedDeal encodeDeal(const GameState &gs) {
+    EncodedDeal deal{};
+    std::array<int, nb_storages> sizes{};
+    int nb_cards = 0;
+    auto push = [&](int slot, const Card &card) {
+        if (nb_cards == deal_size)
+            throw std::invalid_argument("A deal holds more than the 52 cards");
+        deal[nb_cards++] = cardId(card);
+        sizes[slot]++;
+    };
+
+    for (int i = 0; i < nb_freecells; ++i) {
+        auto card = gs.free_cells[i].topCard();
+        if (card.has_value())
+            push(i, *card);
+    }
+    for (int i = 0; i < nb_stacks; ++i) {
+        for (const auto &card : gs.stacks[i].storage())
+            push(nb_freecells + i, card);
+    }
+    for (int i = 0; i < nb_homes; ++i) {
+        // a home holds every card of its color up to the top one
+        auto top = gs.homes[i].topCard();
+        if (!top.has_value())
+            continue;
+        for (int value = 1; value <= top->value; ++value)
+            push(nb_freecells + nb_stacks + i, {top->color, value});
+    }
+
+    if (nb_cards != deal_size)
+        throw std::invalid_argument("A deal holds fewer than the 52 cards");
+
+    SizeBitsWriter bits(deal.data());
+    for (int slot = 0; slot < nb_storages; ++slot)
+        bits.write(sizes[slot], sizeBits(slot));
+
+    return deal;
+}
+
+GameState decodeDeal(const std::uint8_t *bytes) {
+    GameState gs;
+    std::array<bool, deal_size> seen{};
+
+    SizeBitsReader bits(bytes);
+    int nb_cards = 0;
+    for (int slot = 0; slot < nb_storages; ++slot) {
+        int size = bits.read(sizeBits(slot));
+        for (int i = 0; i < size; ++i) {
+            if (nb_cards == deal_size)
+                throw std::runtime_error("Corrupted deal: too many cards");
+
+            std::uint8_t id = bytes[nb_cards++] & card_mask;
+            if (id >= deal_size || seen[id])
+                throw std::runtime_error("Corrupted deal: bad card id");
+            seen[id] = true;
+
+            Card card = cardFromId(id);
+            if (slot < nb_freecells) {
+                gs.free_cells[slot].acceptCard(card);
+            } else if (slot < nb_freecells + nb_stacks) {
+                gs.stacks[slot - nb_freecells].forceCard(card);
+            } else if (!gs.homes[slot - nb_freecells - nb_stacks].acceptCard(card)) {
+                throw std::runtime_error("Corrupted deal: misordered home");
+            }
+        }
+    }
+
+    if (nb_cards != deal_size)
+        throw std::runtime_error("Corrupted deal: missing cards");
+
+    return gs;
+}
+
+void writeDealCorpus(const std::string &path, InitialStateProducerItf &producer, std::uint64_t nb_deals) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Cannot write deal corpus '" + path + "'");
+
+    FileHeader header{};
+    std::memcpy(header.magic, corpus_magic, sizeof(corpus_magic));
+    header.deal_size = deal_size;
+    header.nb_deals = nb_deals;
+
+    // the checksum is only known at the end, the header is written again then
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    Checksum checksum;
+    for (std::uint64_t i = 0; i < nb_deals; ++i) {
+        auto deal = encodeDeal(producer.produce());
+        checksum.add(deal.data(), deal.size());
+        out.write(reinterpret_cast<const char *>(deal.data()), deal.size());
+    }
+
+    header.checksum = checksum.value();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    if (!out)
+        throw std::runtime_error("Failed writing deal corpus '" + path + "'");
+}
+
+CorpusProducer::CorpusProducer(const std::string &path) : path_(path), file_(path) {
+    if (file_.size() < sizeof(FileHeader))
+        throw std::runtime_error("'" + path + "' is not a deal corpus");
+
+    FileHeader header;
+    std::memcpy(&header, file_.data(), sizeof(header));
+    if (std::memcmp(header.magic, corpus_magic, sizeof(corpus_magic)) != 0 || header.deal_size != deal_size)
+        throw std::runtime_error("'" + path + "' is not a deal corpus");
+
+    if ((file_.size() - sizeof(FileHeader)) / deal_size < header.nb_deals)
+        throw std::runtime_error("Deal corpus '" + path + "' is truncated");
+
+    deals_ = file_.data() + sizeof(FileHeader);
+    nb_deals_ = header.nb_deals;
+    checksum_ = header.checksum;
+}
+
+void CorpusProducer::verify() const {
+    Checksum checksum;
+    checksum.add(deals_, nb_deals_ * deal_size);
+    if (checksum.value() != checksum_)
+        throw std::runtime_error("Deal corpus '" + path_ + "' is corrupted");
+}
+
+GameState CorpusProducer::produce() {
+    return produceAt(next_++);
+}
+
+GameState CorpusProducer::produceAt(std::uint64_t index) const {
+    if (index >= nb_deals_)
+        throw std::out_of_range("Deal corpus '" + path_ + "' has only " + std::to_string(nb_deals_) + " deals");
+
+    try {
+        return decodeDeal(deals_ + deal_size * index);
+    } catch (const std::runtime_error &err) {
+        throw std::runtime_error("Deal corpus '" + path_ + "', deal " + std::to_string(index) + ": " + err.what());
+    }
+}
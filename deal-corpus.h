@@ -0,0 +1,52 @@
+#ifndef DEAL_CORPUS_H
+#define DEAL_CORPUS_H
+
+#include "game.h"
+#include "mapped-file.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Binary corpus of deals: a header followed by 52 bytes per deal.
+//
+// A deal is stored as its cards in GameState::all_storage order, each storage
+// from the bottom up, one byte per card. The low six bits of a byte hold the
+// card id, the two high bits of all bytes together hold the number of cards
+// in every storage. The header carries a checksum of all the deals, so the
+// file does not depend on how the random deals were originally generated.
+inline constexpr int deal_size = 4 * king_value;
+using EncodedDeal = std::array<std::uint8_t, deal_size>;
+
+EncodedDeal encodeDeal(const GameState &gs) ;
+GameState decodeDeal(const std::uint8_t *bytes) ;
+
+// writes `nb_deals` deals of `producer` into `path`
+void writeDealCorpus(const std::string &path, InitialStateProducerItf &producer, std::uint64_t nb_deals) ;
+
+// Produces the deals of a corpus in order, mapping the file rather than reading it.
+// Opening only reads the header, each deal is checked as it is decoded;
+// verify() checks the whole file against the checksum.
+class CorpusProducer : public InitialStateProducerItf {
+public:
+    explicit CorpusProducer(const std::string &path);
+
+    // reads every deal, throws std::runtime_error if they do not match the checksum
+    void verify() const;
+    GameState produce() override;
+
+    bool supportsIndexed() const override {return true;}
+    GameState produceAt(std::uint64_t index) const override;
+
+    std::uint64_t nbDeals() const {return nb_deals_;}
+
+private:
+    std::string path_;
+    MappedFile file_;
+    const std::uint8_t *deals_;
+    std::uint64_t nb_deals_;
+    std::uint64_t checksum_;
+    std::uint64_t next_ = 0;
+};
+
+#endif
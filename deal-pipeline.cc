@@ -0,0 +1,80 @@
+#include "deal-pipeline.h"
+
+#include <algorithm>
+
+DealPipeline::DealPipeline(InitialStateProducerItf &producer, std::uint64_t nb_deals, std::size_t nb_threads, std::size_t capacity) :
+        producer_(producer),
+        nb_deals_(nb_deals),
+        capacity_(std::max<std::size_t>(capacity, 1)) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(nb_threads, 1); ++i)
+        threads_.emplace_back(&DealPipeline::generate_, this);
+}
+
+DealPipeline::~DealPipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    not_full_.notify_all();
+
+    for (auto &thread : threads_)
+        thread.join();
+}
+
+void DealPipeline::generate_() {
+    while (true) {
+        std::uint64_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // a deal counts against the capacity from when it is started until it is taken
+            not_full_.wait(lock, [&]{return stop_ || next_index_ - nb_popped_ < capacity_;});
+            if (stop_ || next_index_ == nb_deals_)
+                return;
+            index = next_index_++;
+        }
+
+        try {
+            if (producer_.supportsIndexed()) {
+                Deal deal = producer_.produceDealAt(index);
+                std::lock_guard<std::mutex> lock(mutex_);
+                queue_.push_back(std::move(deal));
+            } else {
+                // the queue gets the deals in the order they were produced
+                std::lock_guard<std::mutex> producer_lock(producer_mutex_);
+                Deal deal = producer_.produceDeal();
+                std::lock_guard<std::mutex> lock(mutex_);
+                queue_.push_back(std::move(deal));
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+            stop_ = true;
+            not_full_.notify_all();
+            not_empty_.notify_all();
+            return;
+        }
+        not_empty_.notify_one();
+    }
+}
+
+std::optional<Deal> DealPipeline::pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [&]{return !queue_.empty() || error_ || nb_popped_ == nb_deals_;});
+
+    if (!queue_.empty()) {
+        Deal deal = std::move(queue_.front());
+        queue_.pop_front();
+        nb_popped_++;
+        bool all_popped = nb_popped_ == nb_deals_;
+        lock.unlock();
+        not_full_.notify_one();
+        if (all_popped)
+            not_empty_.notify_all();
+        return deal;
+    }
+
+    if (error_)
+        std::rethrow_exception(error_);
+
+    return std::nullopt;
+}
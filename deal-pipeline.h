@@ -0,0 +1,54 @@
+#ifndef DEAL_PIPELINE_H
+#define DEAL_PIPELINE_H
+
+#include "game.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Produces the deals 0 .. nb_deals-1 of a producer, with their known solutions,
+// on threads of its own, ahead of the solvers taking them, into a queue of
+// bounded capacity.
+//
+// Producers supporting indexed deals make them in parallel, so the deals are
+// the same whatever the number of threads; they may be taken out of order.
+// Other producers are called in turn, their deals are taken in order.
+class DealPipeline {
+public:
+    DealPipeline(InitialStateProducerItf &producer, std::uint64_t nb_deals, std::size_t nb_threads, std::size_t capacity);
+    ~DealPipeline();
+
+    DealPipeline(const DealPipeline &) = delete;
+    DealPipeline& operator=(const DealPipeline &) = delete;
+
+    // blocks until a deal is ready, nullopt once all of them were taken;
+    // rethrows what the producer threw
+    std::optional<Deal> pop();
+
+private:
+    void generate_();
+
+    InitialStateProducerItf &producer_;
+    const std::uint64_t nb_deals_;
+    const std::size_t capacity_;
+
+    std::mutex mutex_;
+    std::mutex producer_mutex_; // for producers without indexed deals
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<Deal> queue_;
+    std::uint64_t next_index_ = 0;
+    std::uint64_t nb_popped_ = 0;
+    std::exception_ptr error_;
+    bool stop_ = false;
+
+    std::vector<std::thread> threads_;
+};
+
+#endif
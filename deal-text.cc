@@ -0,0 +1,252 @@
+#include "deal-text.h"
+
+#include <cctype>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+constexpr std::string_view rank_chars = "A23456789TJQK";
+constexpr std::string_view suit_chars = "HDCS"; // by Color
+
+bool isSpace(char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && isSpace(text.front()))
+        text.remove_prefix(1);
+    while (!text.empty() && isSpace(text.back()))
+        text.remove_suffix(1);
+    return text;
+}
+
+// removes `prefix` from the front of `text` if it is there, ignoring case
+bool consumePrefix(std::string_view &text, std::string_view prefix) {
+    if (text.size() < prefix.size())
+        return false;
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(text[i])) != prefix[i])
+            return false;
+    }
+    text.remove_prefix(prefix.size());
+    return true;
+}
+
+template <typename F>
+void forEachToken(std::string_view text, F f) {
+    while (true) {
+        text = trim(text);
+        if (text.empty())
+            return;
+        size_t end = 0;
+        while (end < text.size() && !isSpace(text[end]))
+            end++;
+        f(text.substr(0, end));
+        text.remove_prefix(end);
+    }
+}
+
+// 0 for an unknown rank
+int parseRank(std::string_view token) {
+    if (token == "10")
+        return 10;
+    if (token.size() != 1)
+        return 0;
+    auto pos = rank_chars.find(std::toupper(static_cast<unsigned char>(token[0])));
+    return pos == std::string_view::npos ? 0 : pos + 1;
+}
+
+std::optional<Color> parseSuit(char c) {
+    auto pos = suit_chars.find(std::toupper(static_cast<unsigned char>(c)));
+    if (pos == std::string_view::npos)
+        return std::nullopt;
+    return static_cast<Color>(pos);
+}
+
+std::optional<Card> parseCard(std::string_view token) {
+    if (token.size() < 2)
+        return std::nullopt;
+    auto suit = parseSuit(token.back());
+    int rank = parseRank(token.substr(0, token.size() - 1));
+    if (!suit.has_value() || rank == 0)
+        return std::nullopt;
+    return Card{*suit, rank};
+}
+
+void appendCard(std::string &text, const Card &card) {
+    text += rank_chars[card.value - 1];
+    text += suit_chars[static_cast<int>(card.color)];
+}
+
+} // namespace
+
+std::optional<GameState> TextDealReader::next() {
+    GameState gs;
+    std::array<bool, 4 * king_value> seen{};
+    int nb_cards = 0;
+    int nb_stacks_read = 0;
+    int nb_homes_used = 0;
+    bool started = false;
+
+    auto fail = [&](const std::string &what) {
+        throw std::runtime_error("line " + std::to_string(line_nb_) + ": " + what);
+    };
+    auto claim = [&](const Card &card) {
+        auto id = CardIndex::id(card);
+        if (seen[id]) {
+            std::string name;
+            appendCard(name, card);
+            fail("card " + name + " dealt twice");
+        }
+        seen[id] = true;
+        nb_cards++;
+    };
+    auto card = [&](std::string_view token) {
+        auto parsed = parseCard(token);
+        if (!parsed.has_value())
+            fail("unknown card '" + std::string(token) + "'");
+        claim(*parsed);
+        return *parsed;
+    };
+
+    while (nb_stacks_read < nb_stacks && std::getline(in_, line_)) {
+        line_nb_++;
+        auto line = trim(line_);
+        if (line.empty() || line.front() == '#') {
+            if (started)
+                fail("the deal ends after " + std::to_string(nb_stacks_read) + " stacks");
+            continue;
+        }
+        started = true;
+
+        if (consumePrefix(line, "foundations:")) {
+            forEachToken(line, [&](std::string_view token) {
+                // a suit, a dash and the top rank, 0 for none
+                if (token.size() < 3 || token[1] != '-')
+                    fail("unknown foundation '" + std::string(token) + "'");
+                auto suit = parseSuit(token[0]);
+                auto rank = token.substr(2);
+                int top = rank == "0" ? 0 : parseRank(rank);
+                if (!suit.has_value() || (top == 0 && rank != "0"))
+                    fail("unknown foundation '" + std::string(token) + "'");
+                if (top == 0)
+                    return;
+                if (nb_homes_used == nb_homes)
+                    fail("too many foundations");
+                auto &home = gs.homes[nb_homes_used++];
+                for (int value = 1; value <= top; ++value) {
+                    Card home_card{*suit, value};
+                    claim(home_card);
+                    home.acceptCard(home_card);
+                }
+            });
+        } else if (consumePrefix(line, "freecells:")) {
+            int cell = 0;
+            forEachToken(line, [&](std::string_view token) {
+                if (cell == nb_freecells)
+                    fail("too many free cells");
+                if (token != "-")
+                    gs.free_cells[cell].acceptCard(card(token));
+                cell++;
+            });
+        } else {
+            if (line.front() == ':')
+                line.remove_prefix(1);
+            auto &stack = gs.stacks[nb_stacks_read++];
+            forEachToken(line, [&](std::string_view token) {
+                stack.forceCard(card(token));
+            });
+        }
+    }
+
+    if (!started)
+        return std::nullopt;
+    if (nb_stacks_read < nb_stacks)
+        fail("the deal ends after " + std::to_string(nb_stacks_read) + " stacks");
+    if (nb_cards != 4 * king_value)
+        fail("the deal has " + std::to_string(nb_cards) + " cards");
+
+    return gs;
+}
+
+void writeTextDeal(std::ostream &out, const GameState &gs) {
+    std::string text = "Foundations:";
+    std::array<bool, 4> listed{};
+    for (const auto &home : gs.homes) {
+        auto top = home.topCard();
+        if (!top.has_value())
+            continue;
+        text += ' ';
+        text += suit_chars[static_cast<int>(top->color)];
+        text += '-';
+        text += rank_chars[top->value - 1];
+        listed[static_cast<int>(top->color)] = true;
+    }
+    for (int color = 0; color < 4; ++color) {
+        if (listed[color])
+            continue;
+        text += ' ';
+        text += suit_chars[color];
+        text += "-0";
+    }
+
+    text += "\nFreecells:";
+    for (const auto &cell : gs.free_cells) {
+        auto card = cell.topCard();
+        text += ' ';
+        if (card.has_value())
+            appendCard(text, *card);
+        else
+            text += '-';
+    }
+    text += '\n';
+
+    for (const auto &stack : gs.stacks) {
+        text += ':';
+        for (const auto &card : stack.storage()) {
+            text += ' ';
+            appendCard(text, card);
+        }
+        text += '\n';
+    }
+    text += '\n';
+
+    out << text;
+}
+
+std::uint64_t countTextDeals(const std::string &path) {
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("Cannot read deals from '" + path + "'");
+
+    TextDealReader reader(in);
+    std::uint64_t nb_deals = 0;
+    try {
+        while (reader.next().has_value())
+            nb_deals++;
+    } catch (const std::runtime_error &err) {
+        throw std::runtime_error("'" + path + "', " + err.what());
+    }
+    return nb_deals;
+}
+
+TextProducer::TextProducer(const std::string &path) : path_(path), in_(path), reader_(in_) {
+    if (!in_)
+        throw std::runtime_error("Cannot read deals from '" + path + "'");
+}
+
+GameState TextProducer::produce() {
+    std::optional<GameState> gs;
+    try {
+        gs = reader_.next();
+    } catch (const std::runtime_error &err) {
+        throw std::runtime_error("'" + path_ + "', " + err.what());
+    }
+
+    if (!gs.has_value())
+        throw std::out_of_range("No deal left in '" + path_ + "'");
+
+    return std::move(*gs);
+}
@@ -0,0 +1,56 @@
+#ifndef DEAL_TEXT_H
+#define DEAL_TEXT_H
+
+#include "game.h"
+
+#include <cstdint>
+#include <fstream>
+#include <iosfwd>
+#include <optional>
+#include <string>
+
+// Plain-text deals in the layout common to FreeCell solvers:
+//
+//   Foundations: H-A C-0 D-0 S-0
+//   Freecells: 8D - - QC
+//   : 4C 2C 9C 8C QS 4S 2H
+//   ...
+//
+// then one line per stack from its bottom card up, optionally starting with ':'
+// (an empty stack is a lone ':'). The foundations and free cells lines may be
+// left out. Ranks are A, 2-9, T (or 10), J, Q, K, suits H, D, C, S, in either case.
+// A deal ends with its eighth stack; blank lines and lines starting with '#'
+// are skipped.
+class TextDealReader {
+public:
+    explicit TextDealReader(std::istream &in) : in_(in) {}
+
+    // the next deal, nullopt at the end of the input;
+    // throws std::runtime_error naming the line of a malformed deal
+    std::optional<GameState> next();
+
+private:
+    std::istream &in_;
+    std::string line_;
+    int line_nb_ = 0;
+};
+
+// writes the deal in the layout read by TextDealReader, followed by a blank line
+void writeTextDeal(std::ostream &out, const GameState &gs) ;
+
+// number of deals in the file at `path`; throws std::runtime_error as TextDealReader does
+std::uint64_t countTextDeals(const std::string &path) ;
+
+// Produces the deals of a text file in order, reading it as they are needed.
+class TextProducer : public InitialStateProducerItf {
+public:
+    explicit TextProducer(const std::string &path);
+    GameState produce() override;
+
+private:
+    std::string path_;
+    std::ifstream in_;
+    TextDealReader reader_;
+};
+
+#endif
@@ -0,0 +1,407 @@
+#include "endgame-db.h"
+#include "search-interface.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr char endgame_magic[8] = {'F', 'C', 'E', 'G', 'D', 'B', '0', '1'};
+constexpr std::uint8_t lost = 0xfe;
+constexpr std::uint8_t no_position = 0xff;
+constexpr char separator = static_cast<char>(CardIndex::nowhere);
+
+// positions per bucket and slots per position, on average
+constexpr std::size_t bucket_size = 4;
+constexpr std::size_t slack = 50;
+constexpr std::uint32_t max_displacement = 1u << 24;
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t max_cards;
+    std::uint32_t supermoves;
+    std::uint32_t autoplay;
+    std::uint32_t reserved;
+    std::uint64_t nb_positions;
+    std::uint64_t nb_buckets;
+    std::uint64_t nb_slots;
+};
+
+int nbOut(const GameState &gs) {
+    int nb_out = 4 * king_value;
+    for (auto color : colors_list)
+        nb_out -= gs.homeValue(color);
+    return nb_out;
+}
+
+Card cardFromId(std::uint8_t id) {
+    return {static_cast<Color>(id / king_value), id % king_value + 1};
+}
+
+// the free cells sorted, then the stacks sorted, each closed by a separator;
+// the homes follow from the cards which are out
+std::string positionKey(const GameState &gs) {
+    std::array<std::uint8_t, nb_freecells> cells;
+    for (int i = 0; i < nb_freecells; ++i) {
+        auto card = gs.free_cells[i].topCard();
+        cells[i] = card.has_value() ? CardIndex::id(*card) : CardIndex::nowhere;
+    }
+    std::sort(cells.begin(), cells.end());
+
+    std::array<std::string, nb_stacks> stacks;
+    for (int i = 0; i < nb_stacks; ++i) {
+        for (const auto &card : gs.stacks[i].storage())
+            stacks[i].push_back(static_cast<char>(CardIndex::id(card)));
+    }
+    std::sort(stacks.begin(), stacks.end());
+
+    std::string key(cells.begin(), cells.end());
+    for (const auto &stack : stacks) {
+        key += stack;
+        key.push_back(separator);
+    }
+    return key;
+}
+
+GameState positionState(const std::string &key) {
+    GameState gs;
+    std::array<int, 4> lowest_out;
+    lowest_out.fill(king_value + 1);
+    auto take = [&](char byte) {
+        Card card = cardFromId(static_cast<std::uint8_t>(byte));
+        int &lowest = lowest_out[static_cast<int>(card.color)];
+        lowest = std::min(lowest, card.value);
+        return card;
+    };
+
+    std::size_t pos = 0;
+    for (int i = 0; i < nb_freecells; ++i, ++pos) {
+        if (key[pos] != separator)
+            gs.free_cells[i].acceptCard(take(key[pos]));
+    }
+    for (int i = 0; i < nb_stacks; ++i, ++pos) {
+        for (; key[pos] != separator; ++pos)
+            gs.stacks[i].forceCard(take(key[pos]));
+    }
+
+    for (size_t i = 0; i < colors_list.size(); ++i) {
+        auto color = colors_list[i];
+        for (int value = 1; value < lowest_out[static_cast<int>(color)]; ++value)
+            gs.homes[i].acceptCard({color, value});
+    }
+    return gs;
+}
+
+std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// FNV-1a, mixed as the low bits pick the bucket
+std::uint64_t positionHash(const std::string &key) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char byte : key) {
+        hash ^= static_cast<std::uint8_t>(byte);
+        hash *= 0x100000001b3ULL;
+    }
+    return mix(hash);
+}
+
+std::size_t slotOf(std::uint64_t hash, std::uint32_t displacement, std::size_t nb_slots) {
+    return mix(hash + displacement * 0x9e3779b97f4a7c15ULL) % nb_slots;
+}
+
+std::uint32_t fingerprint(std::uint64_t hash) {
+    return hash >> 40;
+}
+
+// Calls visit(cells, piles) for every way to lay out the `cards` ids into the
+// free cells and up to nb_stacks piles, neither of them in any particular order.
+// Each card goes into a cell, anywhere into a pile or into a pile of its own.
+template <typename Visit>
+void arrangements(const std::string &cards, std::size_t next, std::string &cells, std::vector<std::string> &piles, Visit &visit) {
+    if (next == cards.size()) {
+        visit(cells, piles);
+        return;
+    }
+
+    char card = cards[next];
+    if (cells.size() < static_cast<std::size_t>(nb_freecells)) {
+        cells.push_back(card);
+        arrangements(cards, next + 1, cells, piles, visit);
+        cells.pop_back();
+    }
+
+    // by index, the piles may move while deeper calls add theirs
+    for (std::size_t p = 0; p < piles.size(); ++p) {
+        for (std::size_t pos = 0; pos <= piles[p].size(); ++pos) {
+            piles[p].insert(pos, 1, card);
+            arrangements(cards, next + 1, cells, piles, visit);
+            piles[p].erase(pos, 1);
+        }
+    }
+
+    if (piles.size() < static_cast<std::size_t>(nb_stacks)) {
+        piles.emplace_back(1, card);
+        arrangements(cards, next + 1, cells, piles, visit);
+        piles.pop_back();
+    }
+}
+
+// keys of the settled positions with 1 to max_cards cards out of the homes
+std::vector<std::string> enumeratePositions(int max_cards) {
+    std::vector<std::string> keys;
+    auto visit = [&](const std::string &cells, const std::vector<std::string> &piles) {
+        std::string raw_key = cells;
+        raw_key.resize(nb_freecells, separator);
+        for (size_t i = 0; i < nb_stacks; ++i) {
+            if (i < piles.size())
+                raw_key += piles[i];
+            raw_key.push_back(separator);
+        }
+        // a position whose safe moves are left is never searched
+        GameState position = positionState(raw_key);
+        auto key = positionKey(position);
+        if (nbOut(SearchState::settled(position).gameState()) == nbOut(position))
+            keys.push_back(std::move(key));
+    };
+
+    std::array<int, 4> nb_out{};
+    while (true) {
+        int total = nb_out[0] + nb_out[1] + nb_out[2] + nb_out[3];
+        if (total > 0 && total <= max_cards) {
+            std::string cards;
+            for (auto color : colors_list) {
+                for (int i = 0; i < nb_out[static_cast<int>(color)]; ++i)
+                    cards.push_back(static_cast<char>(CardIndex::id({color, king_value - i})));
+            }
+            std::string cells;
+            std::vector<std::string> piles;
+            arrangements(cards, 0, cells, piles, visit);
+        }
+
+        // next count of cards out per suit
+        int suit = 0;
+        while (suit < 4 && nb_out[suit] == std::min(max_cards, king_value)) {
+            nb_out[suit] = 0;
+            suit++;
+        }
+        if (suit == 4)
+            break;
+        nb_out[suit]++;
+    }
+
+    return keys;
+}
+
+// exact distances of the positions, `lost` for those which can not be won
+std::vector<std::uint8_t> solvePositions(const std::vector<std::string> &keys) {
+    std::unordered_map<std::string, std::uint32_t> index;
+    for (std::uint32_t i = 0; i < keys.size(); ++i)
+        index.emplace(keys[i], i);
+
+    // the positions one action away from each position, as (child, parent)
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;
+    std::vector<std::uint8_t> distances(keys.size(), lost);
+    std::vector<std::uint32_t> queue;
+    ActionList actions;
+
+    for (std::uint32_t i = 0; i < keys.size(); ++i) {
+        SearchState state(positionState(keys[i]));
+        state.actions(actions);
+        for (const auto &action : actions) {
+            SearchState child = action.execute(state);
+            if (child.isWon()) {
+                if (distances[i] == lost) {
+                    distances[i] = 1;
+                    queue.push_back(i);
+                }
+                continue;
+            }
+            auto it = index.find(positionKey(child.gameState()));
+            if (it != index.end())
+                edges.emplace_back(it->second, i);
+        }
+    }
+
+    // retrograde BFS: parents of a position at distance d are at most d + 1 away
+    std::sort(edges.begin(), edges.end());
+    std::vector<std::size_t> first_edge(keys.size() + 1, 0);
+    for (const auto &edge : edges)
+        first_edge[edge.first + 1]++;
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        first_edge[i + 1] += first_edge[i];
+
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        auto position = queue[head];
+        int distance = distances[position] + 1;
+        if (distance >= lost)
+            throw std::logic_error("Endgame distance out of range");
+        for (auto e = first_edge[position]; e < first_edge[position + 1]; ++e) {
+            auto parent = edges[e].second;
+            if (distances[parent] == lost) {
+                distances[parent] = distance;
+                queue.push_back(parent);
+            }
+        }
+    }
+
+    return distances;
+}
+
+} // namespace
+
+void EndgameDatabase::build(const std::string &path, int max_cards) {
+    if (max_cards < 1 || max_cards > 4 * king_value)
+        throw std::out_of_range("Endgame database needs between 1 and 52 cards");
+
+    auto keys = enumeratePositions(max_cards);
+    auto distances = solvePositions(keys);
+
+    std::vector<std::uint64_t> hashes(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        hashes[i] = positionHash(keys[i]);
+
+    std::size_t nb_buckets = keys.size() / bucket_size + 1;
+    std::size_t nb_slots = keys.size() + keys.size() / slack + 1;
+    std::vector<std::vector<std::uint32_t>> buckets(nb_buckets);
+    for (std::uint32_t i = 0; i < keys.size(); ++i)
+        buckets[hashes[i] % nb_buckets].push_back(i);
+
+    // the largest buckets first, while there is still room
+    std::vector<std::uint32_t> order(nb_buckets);
+    for (std::uint32_t i = 0; i < nb_buckets; ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](auto a, auto b){return buckets[a].size() > buckets[b].size();});
+
+    std::vector<std::uint32_t> displacements(nb_buckets, 0);
+    std::vector<std::uint32_t> slots(nb_slots, no_position);
+    std::vector<bool> taken(nb_slots, false);
+    std::vector<std::size_t> candidate;
+    for (auto b : order) {
+        const auto &bucket = buckets[b];
+        if (bucket.empty())
+            break;
+
+        std::uint32_t displacement = 0;
+        for (;; ++displacement) {
+            if (displacement == max_displacement)
+                throw std::runtime_error("Cannot place the endgame positions into the table");
+
+            candidate.clear();
+            bool fits = true;
+            for (auto position : bucket) {
+                auto slot = slotOf(hashes[position], displacement, nb_slots);
+                if (taken[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+                    fits = false;
+                    break;
+                }
+                candidate.push_back(slot);
+            }
+            if (fits)
+                break;
+        }
+
+        displacements[b] = displacement;
+        for (size_t i = 0; i < bucket.size(); ++i) {
+            taken[candidate[i]] = true;
+            slots[candidate[i]] = fingerprint(hashes[bucket[i]]) << 8 | distances[bucket[i]];
+        }
+    }
+
+    FileHeader header;
+    std::memcpy(header.magic, endgame_magic, sizeof(endgame_magic));
+    header.max_cards = max_cards;
+    header.supermoves = SearchState::supermovesEnabled();
+    header.autoplay = static_cast<std::uint32_t>(SearchState::autoplay());
+    header.reserved = 0;
+    header.nb_positions = keys.size();
+    header.nb_buckets = nb_buckets;
+    header.nb_slots = nb_slots;
+
+    auto tmp_path = temporaryPath(path);
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Cannot write endgame database '" + tmp_path + "'");
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(displacements.data()), displacements.size() * sizeof(std::uint32_t));
+    out.write(reinterpret_cast<const char *>(slots.data()), slots.size() * sizeof(std::uint32_t));
+
+    out.close();
+    if (!out) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Failed writing endgame database '" + tmp_path + "'");
+    }
+    publishFile(tmp_path, path);
+}
+
+EndgameDatabase::EndgameDatabase(const std::string &path) : file_(path) {
+    if (file_.size() < sizeof(FileHeader))
+        throw std::runtime_error("'" + path + "' is not an endgame database");
+
+    FileHeader header;
+    std::memcpy(&header, file_.data(), sizeof(header));
+    if (std::memcmp(header.magic, endgame_magic, sizeof(endgame_magic)) != 0)
+        throw std::runtime_error("'" + path + "' is not an endgame database");
+
+    if (header.nb_buckets == 0 || header.nb_slots == 0 ||
+            file_.size() != sizeof(FileHeader) + (header.nb_buckets + header.nb_slots) * sizeof(std::uint32_t))
+        throw std::runtime_error("Endgame database '" + path + "' is corrupted");
+
+    if (header.supermoves != SearchState::supermovesEnabled() || header.autoplay != static_cast<std::uint32_t>(SearchState::autoplay()))
+        throw std::runtime_error("Endgame database '" + path + "' was built for other supermove or autoplay settings");
+
+    max_cards_ = header.max_cards;
+    nb_positions_ = header.nb_positions;
+    nb_buckets_ = header.nb_buckets;
+    nb_slots_ = header.nb_slots;
+    // the header keeps the tables 4-byte aligned in the mapping
+    displacements_ = reinterpret_cast<const std::uint32_t *>(file_.data() + sizeof(FileHeader));
+    slots_ = displacements_ + nb_buckets_;
+}
+
+std::shared_ptr<const EndgameDatabase> EndgameDatabase::open(const std::string &path, int max_cards) {
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const EndgameDatabase>> opened;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto db = opened[path].lock();
+    if (!db) {
+        if (!std::ifstream(path))
+            build(path, max_cards);
+        db = std::make_shared<const EndgameDatabase>(path);
+        opened[path] = db;
+    }
+
+    if (db->maxCards() != max_cards)
+        throw std::runtime_error("Endgame database '" + path + "' was built for " + std::to_string(db->maxCards()) + " cards");
+    return db;
+}
+
+std::optional<int> EndgameDatabase::distance(const GameState &state) const {
+    int nb_out = nbOut(state);
+    if (nb_out == 0)
+        return 0;
+    if (nb_out > max_cards_)
+        return std::nullopt;
+
+    auto hash = positionHash(positionKey(state));
+    auto entry = slots_[slotOf(hash, displacements_[hash % nb_buckets_], nb_slots_)];
+    std::uint8_t distance = entry & 0xff;
+    if (entry >> 8 != fingerprint(hash) || distance >= lost)
+        return std::nullopt;
+    return distance;
+}
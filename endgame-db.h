@@ -0,0 +1,53 @@
+#ifndef ENDGAME_DB_H
+#define ENDGAME_DB_H
+
+#include "game.h"
+#include "mapped-file.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+
+// Exact number of actions left from every position with at most max_cards
+// cards out of the homes, under the SearchState rules (supermoves, autoplay)
+// in force when it was built.
+//
+// Such positions only lead to positions like them, so they are solved
+// in isolation: every one is enumerated, up to which free cells and stacks
+// hold what, the moves between them are generated and the distances spread
+// by a retrograde BFS from the won state.
+//
+// The table holds one 32-bit entry per position, a fingerprint and the
+// distance, at the slot given by a minimal-ish perfect hash in the
+// hash-and-displace fashion: positions are split into small buckets, each
+// bucket stores the displacement which sends all of its positions to free slots.
+// Tables are written to a file once and memory-mapped by every user.
+class EndgameDatabase {
+public:
+    explicit EndgameDatabase(const std::string &path);
+
+    // solves the positions and writes the table into `path`
+    static void build(const std::string &path, int max_cards);
+
+    // maps `path`, building it first if it does not exist;
+    // throws if it was built for other rules or another number of cards
+    static std::shared_ptr<const EndgameDatabase> open(const std::string &path, int max_cards);
+
+    int maxCards() const {return max_cards_;}
+    std::size_t nbPositions() const {return nb_positions_;}
+
+    // actions left to win from a settled `state`, nullopt if it has too many
+    // cards out of the homes or can not be won
+    std::optional<int> distance(const GameState &state) const;
+
+private:
+    MappedFile file_;
+    int max_cards_;
+    std::size_t nb_positions_;
+    std::size_t nb_buckets_;
+    std::size_t nb_slots_;
+    const std::uint32_t *displacements_;
+    const std::uint32_t *slots_;
+};
+
+#endif
@@ -1,5 +1,93 @@
 #include "evaluation-type.h"
 
+#include <algorithm>
+#include <cmath>
+
+std::size_t LogHistogram::bucketIndex(std::uint64_t value) {
+    if (value < nb_exact_)
+        return value;
+
+    int msb = 0;
+    for (std::uint64_t v = value; v > 1; v >>= 1)
+        ++msb;
+
+    // value >> shift falls into [nb_sub_buckets_, 2*nb_sub_buckets_)
+    int shift = msb - sub_bucket_bits_;
+    std::size_t top = value >> shift;
+    return nb_exact_ + (shift - 1) * nb_sub_buckets_ + (top - nb_sub_buckets_);
+}
+
+std::uint64_t LogHistogram::bucketUpperBound(std::size_t index) {
+    if (index < nb_exact_)
+        return index;
+
+    int shift = (index - nb_exact_) / nb_sub_buckets_ + 1;
+    std::uint64_t top = (index - nb_exact_) % nb_sub_buckets_ + nb_sub_buckets_;
+    return ((top + 1) << shift) - 1;
+}
+
+void LogHistogram::record(std::uint64_t value) {
+    counts_[bucketIndex(value)]++;
+    count_++;
+    max_ = std::max(max_, value);
+    sum_ += value;
+}
+
+void LogHistogram::merge(const LogHistogram &other) {
+    for (std::size_t i = 0; i < nb_buckets_; ++i)
+        counts_[i] += other.counts_[i];
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+}
+
+double LogHistogram::mean() const {
+    if (count_ == 0)
+        return 0.0;
+    return static_cast<double>(sum_ / count_);
+}
+
+std::uint64_t LogHistogram::percentile(double p) const {
+    if (count_ == 0)
+        return 0;
+
+    auto rank = static_cast<std::uint64_t>(std::ceil(p / 100.0 * count_));
+    rank = std::clamp<std::uint64_t>(rank, 1, count_);
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < nb_buckets_; ++i) {
+        seen += counts_[i];
+        if (seen >= rank)
+            return std::min(bucketUpperBound(i), max_);
+    }
+
+    return max_;
+}
+
+StrategyEvaluation& StrategyEvaluation::operator+=(const StrategyEvaluation &other) {
+    nb_solved += other.nb_solved;
+    nb_failed += other.nb_failed;
+    total_solution_length += other.total_solution_length;
+    nb_states_expanded += other.nb_states_expanded;
+    time_taken += other.time_taken;
+    time_distribution.merge(other.time_distribution);
+    first_solution_distribution.merge(other.first_solution_distribution);
+    expansions_distribution.merge(other.expansions_distribution);
+    bound_ratio_distribution.merge(other.bound_ratio_distribution);
+
+    return *this;
+}
+
+std::ostream& operator<< (std::ostream& os, const LogHistogram &histogram) {
+    os << "mean " << histogram.mean() <<
+        ", p50 " << histogram.percentile(50) <<
+        ", p90 " << histogram.percentile(90) <<
+        ", p99 " << histogram.percentile(99) <<
+        ", max " << histogram.max();
+
+    return os;
+}
+
 std::ostream& operator<< (std::ostream& os, const StrategyEvaluation &report) {
     if (report.nb_solved > 0) {
         os << "Solved " << report.nb_solved << " / " << report.nb_solved + report.nb_failed <<
@@ -8,6 +96,12 @@ std::ostream& operator<< (std::ostream& os, const StrategyEvaluation &report) {
             "Avg time taken: " << (report.time_taken / report.nb_solved).count() << " us " <<
             "Total #states expaned: " << report.nb_states_expanded << 
             "\n";
+        os << "  Time taken [us]: " << report.time_distribution << "\n";
+        os << "  Time to first solution [us]: " << report.first_solution_distribution << "\n";
+        os << "  #states expanded: " << report.expansions_distribution << "\n";
+        if (report.bound_ratio_distribution.count() > 0)
+            os << "  Length / known solution [%] (" << report.bound_ratio_distribution.count() << " games): " <<
+                report.bound_ratio_distribution << "\n";
     } else {
         os << "Solved " << report.nb_solved << " / " << report.nb_solved + report.nb_failed <<
             " [ 0 % ]. " <<
@@ -1,9 +1,43 @@
 #ifndef EVALUATION_TYPE_H
 #define EVALUATION_TYPE_H
 
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
 
+// Log-bucketed histogram in the spirit of HdrHistogram:
+// values below 32 are counted exactly, above that every power of two
+// is split into 16 linear sub-buckets, giving ~6 % relative precision
+// over the whole 64-bit range at a fixed size.
+// Histograms collected in different threads can be merged.
+class LogHistogram {
+public:
+    void record(std::uint64_t value);
+    void merge(const LogHistogram &other);
+
+    std::uint64_t count() const {return count_;}
+    std::uint64_t max() const {return max_;}
+    double mean() const;
+
+    // upper bound of the bucket holding the p-th percentile, p in [0, 100]
+    std::uint64_t percentile(double p) const;
+
+private:
+    static constexpr int sub_bucket_bits_ = 4;
+    static constexpr std::size_t nb_exact_ = std::size_t{2} << sub_bucket_bits_;
+    static constexpr std::size_t nb_sub_buckets_ = std::size_t{1} << sub_bucket_bits_;
+    static constexpr std::size_t nb_buckets_ = nb_exact_ + (64 - sub_bucket_bits_ - 1) * nb_sub_buckets_;
+
+    static std::size_t bucketIndex(std::uint64_t value);
+    static std::uint64_t bucketUpperBound(std::size_t index);
+
+    std::array<std::uint64_t, nb_buckets_> counts_{};
+    std::uint64_t count_ = 0;
+    std::uint64_t max_ = 0;
+    long double sum_ = 0;
+};
+
 struct StrategyEvaluation {
 	StrategyEvaluation() : nb_solved(0), nb_failed(0), total_solution_length(0), nb_states_expanded(0), time_taken(0) {}
     unsigned long nb_solved;
@@ -11,8 +45,18 @@ struct StrategyEvaluation {
     unsigned long total_solution_length;
     unsigned long long nb_states_expanded;
     std::chrono::microseconds time_taken;
+
+    // per solved game
+    LogHistogram time_distribution; // in us
+    LogHistogram first_solution_distribution; // in us
+    LogHistogram expansions_distribution;
+    // solution length in % of the one the producer knew, for games it knew one of
+    LogHistogram bound_ratio_distribution;
+
+    StrategyEvaluation& operator+=(const StrategyEvaluation &other);
 };
 
+std::ostream& operator<< (std::ostream& os, const LogHistogram &histogram) ;
 std::ostream& operator<< (std::ostream& os, const StrategyEvaluation &report) ;
 
 #endif
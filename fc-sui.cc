@@ -2,15 +2,26 @@
 #include "game.h"
 #include "search-interface.h"
 #include "search-strategies.h"
+#include "deal-corpus.h"
+#include "deal-text.h"
+#include "deal-pipeline.h"
+#include "endgame-db.h"
+#include "solution-cache.h"
 
 #include "evaluation-type.h"
 #include "argparse.h"
 #include "mem_watch.h"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <exception>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
 
 #include <thread>
 #include <atomic>
@@ -18,59 +29,286 @@
 
 void eval_strategy(
         std::unique_ptr<SearchStrategyItf> &search_strategy,
-        const SearchState &init_state,
+        const Deal &deal,
+        bool expand_supermoves,
+        bool bound_by_known,
+        SolutionCache *cache,
+        bool refresh_cache,
         StrategyEvaluation *report
     ) {
+    SearchState init_state(deal.state);
 
-    auto t0 = std::chrono::steady_clock::now();
-	auto solution = search_strategy->solve(init_state);
-    auto t1 = std::chrono::steady_clock::now();
+    std::optional<std::vector<SearchAction>> known;
+    if (deal.known_solution.has_value())
+        known = replaySolution(init_state, *deal.known_solution);
 
+    // replaying the single-card steps also checks how supermoves were split;
+    // a solution counts once it wins, reaching the endgame database is not enough
+    auto replay = [&](const std::vector<SearchAction> &solution) {
+        SearchState in_progress(init_state);
+        size_t solution_length = 0;
+        for (const auto & action : solution) {
+            if (expand_supermoves) {
+                for (const auto & step : action.expand(in_progress)) {
+                    in_progress = step.execute(in_progress);
+                    solution_length++;
+                }
+            } else {
+                in_progress = action.execute(in_progress);
+                solution_length++;
+            }
+        }
+        return std::make_pair(in_progress.isWon(), solution_length);
+    };
 
-	SearchState in_progress(init_state);
-	for (const auto & action : solution)
-		in_progress = action.execute(in_progress);
+    std::optional<SolutionCache::Entry> outcome;
+    std::pair<bool, size_t> replayed;
+    if (cache && !refresh_cache) {
+        outcome = cache->find(deal.state);
+        if (outcome.has_value()) {
+            replayed = replay(outcome->solution);
+            // a cached solution is only trusted once it wins the deal again
+            if (replayed.first != outcome->solved) {
+                std::cerr << "Cached outcome does not replay, solving the deal again\n";
+                outcome.reset();
+            }
+        }
+    }
+
+    if (!outcome.has_value()) {
+        if (bound_by_known && known.has_value()) {
+            if (auto dfbnb = dynamic_cast<DepthFirstBranchAndBound *>(search_strategy.get()))
+                dfbnb->setUpperBound(known->size(), *known);
+        }
+
+        std::optional<std::chrono::steady_clock::time_point> t_first;
+        search_strategy->onSolution([&](const std::vector<SearchAction> &) {
+            if (!t_first.has_value())
+                t_first = std::chrono::steady_clock::now();
+        });
+
+        auto expanded_before = SearchState::nbExpanded();
+        auto t0 = std::chrono::steady_clock::now();
+        auto solution = completeSolution(init_state, search_strategy->solve(init_state));
+        auto t1 = std::chrono::steady_clock::now();
 
-    if (in_progress.isFinal()) {
+        replayed = replay(solution);
+        outcome = SolutionCache::Entry{
+            replayed.first,
+            replayed.first ? std::move(solution) : std::vector<SearchAction>{},
+            SearchState::nbExpanded() - expanded_before,
+            std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0),
+            // strategies which do not publish intermediate solutions find their first one at the end
+            std::chrono::duration_cast<std::chrono::microseconds>(t_first.value_or(t1) - t0),
+        };
+        if (cache)
+            cache->store(deal.state, *outcome);
+    }
+
+    auto [solved, solution_length] = replayed;
+    if (solved) {
         report->nb_solved++;
-        report->total_solution_length += solution.size();
-        report->time_taken += std::chrono::duration_cast<decltype(report->time_taken)>(t1 - t0);
+        report->total_solution_length += solution_length;
+        report->time_taken += outcome->time_taken;
+        report->time_distribution.record(outcome->time_taken.count());
+        report->first_solution_distribution.record(outcome->first_solution_time.count());
+        report->expansions_distribution.record(outcome->nb_expanded);
+
+        if (known.has_value() && !known->empty())
+            report->bound_ratio_distribution.record(100 * solution_length / known->size());
     } else {
         report->nb_failed++;
     }
-    report->nb_states_expanded = SearchState::nbExpanded();
+    report->nb_states_expanded += outcome->nb_expanded;
+}
+
+// the Microsoft deal numbers of --deals A-B (or a single A)
+std::pair<std::uint32_t, std::uint32_t> getDealRange(const argparse::ArgumentParser &parser) {
+    auto range = parser.get<std::string>("--deals");
+    try {
+        std::size_t end;
+        auto first = std::stoul(range, &end);
+        auto last = first;
+        if (end < range.size()) {
+            if (range[end] != '-')
+                throw std::invalid_argument(range);
+            std::size_t last_end;
+            last = std::stoul(range.substr(end + 1), &last_end);
+            if (end + 1 + last_end != range.size())
+                throw std::invalid_argument(range);
+        }
+        if (first < 1 || last < first || last > 0x7fffffff)
+            throw std::invalid_argument(range);
+        return {first, last};
+    } catch (const std::logic_error &) {
+        std::cerr << "Invalid deal range '" << range << "', expected A-B with 1 <= A <= B\n";
+        std::exit(2);
+    }
+}
+
+// nb_games, or fewer if the deal files hold fewer
+int getNbGames(const argparse::ArgumentParser &parser) {
+    if (parser.is_used("--deals")) {
+        auto [first, last] = getDealRange(parser);
+        return last - first + 1;
+    }
+
+    auto nb_games = parser.get<int>("nb_games");
+    if (parser.is_used("--corpus")) {
+        auto nb_deals = CorpusProducer(parser.get<std::string>("--corpus")).nbDeals();
+        return static_cast<int>(std::min<std::uint64_t>(std::max(nb_games, 0), nb_deals));
+    } else if (parser.is_used("--text-deals")) {
+        auto nb_deals = countTextDeals(parser.get<std::string>("--text-deals"));
+        return static_cast<int>(std::min<std::uint64_t>(std::max(nb_games, 0), nb_deals));
+    }
+    return nb_games;
 }
 
 std::unique_ptr<InitialStateProducerItf> getProducer(const argparse::ArgumentParser &parser) {
     auto difficulty = parser.get<int>("--easy-mode");
     auto seed = parser.get<int>("seed");
 
-    if (difficulty < 0) {
+    if (parser.is_used("--deals")) {
+        auto [first, last] = getDealRange(parser);
+        return std::make_unique<MicrosoftProducer>(first, last);
+    } else if (parser.is_used("--corpus")) {
+        auto corpus = std::make_unique<CorpusProducer>(parser.get<std::string>("--corpus"));
+        if (parser.get<bool>("--verify-corpus"))
+            corpus->verify();
+        return corpus;
+    } else if (parser.is_used("--text-deals")) {
+        return std::make_unique<TextProducer>(parser.get<std::string>("--text-deals"));
+    } else if (difficulty < 0) {
         return std::make_unique<RandomProducer>(seed);
     } else {
         return std::make_unique<EasyProducer>(seed, difficulty);
     }
 }
 
-std::unique_ptr<AStarHeuristicItf> getHeuristic(const argparse::ArgumentParser &parser) {
-    auto heuristic_name = parser.get<std::string>("--heuristic");
+// produce() gives the indexed deals 0, 1, ... of another producer
+class IndexedProducer : public InitialStateProducerItf {
+public:
+    explicit IndexedProducer(const InitialStateProducerItf &source) : source_(source) {}
+    GameState produce() override {return source_.produceAt(next_++);}
+    Deal produceDeal() override {return source_.produceDealAt(next_++);}
+
+private:
+    const InitialStateProducerItf &source_;
+    std::uint64_t next_ = 0;
+};
+
+std::unique_ptr<AStarHeuristicItf> makeHeuristic(const std::string &heuristic_name, const argparse::ArgumentParser &parser) {
+    const std::string max_prefix = "max:";
 
     if (heuristic_name == "nb_not_home") {
         return std::make_unique<OufOfHome_Pseudo>();
+    } else if (heuristic_name == "blocked") {
+        return std::make_unique<BlockedCardsHeuristic>();
+    } else if (heuristic_name == "pdb") {
+        return std::make_unique<PatternDbHeuristic>(parser.get<std::string>("--pdb-file"));
     } else if (heuristic_name == "student") {
 	    return std::make_unique<StudentHeuristic>();
+    } else if (heuristic_name.compare(0, max_prefix.size(), max_prefix) == 0) {
+        std::vector<std::unique_ptr<AStarHeuristicItf>> components;
+        std::stringstream names(heuristic_name.substr(max_prefix.size()));
+        std::string name;
+        while (std::getline(names, name, ','))
+            components.push_back(makeHeuristic(name, parser));
+        return std::make_unique<MaxHeuristic>(std::move(components));
     } else {
         std::cerr << "Unknown heuristic name '" << heuristic_name << "'\n";
-        std::cerr << "Supported are: nb_not_home, student\n";
+        std::cerr << "Supported are: nb_not_home, blocked, pdb, student and max:NAME,NAME,...\n";
         std::exit(2);
     }
 }
 
+std::unique_ptr<AStarHeuristicItf> getHeuristic(const argparse::ArgumentParser &parser) {
+    return makeHeuristic(parser.get<std::string>("--heuristic"), parser);
+}
+
+AutoplayMode getAutoplay(const argparse::ArgumentParser &parser) {
+    auto mode_name = parser.get<std::string>("--autoplay");
+
+    if (mode_name == "conservative") {
+        return AutoplayMode::Conservative;
+    } else if (mode_name == "aggressive") {
+        return AutoplayMode::Aggressive;
+    } else {
+        std::cerr << "Unknown autoplay mode '" << mode_name << "'\n";
+        std::cerr << "Supported are: conservative, aggressive\n";
+        std::exit(2);
+    }
+}
+
+void setPruning(const argparse::ArgumentParser &parser) {
+    auto rule_names = parser.get<std::string>("--prune");
+    if (rule_names == "none")
+        return;
+
+    if (rule_names == "all") {
+        for (int i = 0; i < nb_pruning_rules; ++i)
+            MovePruning::enable(MovePruning::rule(i), true);
+        return;
+    }
+
+    std::stringstream names(rule_names);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        auto rule = MovePruning::fromName(name);
+        if (!rule.has_value()) {
+            std::cerr << "Unknown pruning rule '" << name << "'\n";
+            std::cerr << "Supported are: all, none or a list of cell_to_cell, lone_to_empty, empty_targets, undo\n";
+            std::exit(2);
+        }
+        MovePruning::enable(*rule, true);
+    }
+}
+
 std::unique_ptr<SearchStrategyItf> getSolver(const argparse::ArgumentParser &parser) {
     auto solver_name = parser.get<std::string>("--solver");
 
     if (solver_name == "dummy") {
-        return std::make_unique<DummySearch>(500, 5);
+        return std::make_unique<DummySearch>(
+            parser.get<size_t>("--max-depth"),
+            parser.get<size_t>("--attempts"),
+            parser.get<size_t>("--threads")
+        );
+    } else if (solver_name == "nmcs") {
+        return std::make_unique<NestedMonteCarloSearch>(parser.get<int>("--level"), parser.get<size_t>("--max-depth"));
+    } else if (solver_name == "beam") {
+        return std::make_unique<BeamSearch>(getHeuristic(parser), parser.get<size_t>("--beam-width"), parser.get<size_t>("--max-depth"));
+    } else if (solver_name == "anytime_a_star") {
+        return std::make_unique<AnytimeAStarSearch>(
+            getHeuristic(parser),
+            parser.get<double>("--weight"),
+            parser.get<double>("--weight-step"),
+            std::chrono::milliseconds(parser.get<int>("--time-limit"))
+        );
+    } else if (solver_name == "dfbnb") {
+        auto bound = parser.get<std::string>("--dfbnb-bound");
+        std::unique_ptr<SearchStrategyItf> initial;
+        if (bound == "beam") {
+            initial = std::make_unique<BeamSearch>(getHeuristic(parser), parser.get<size_t>("--beam-width"), parser.get<size_t>("--max-depth"));
+        } else if (bound != "none" && bound != "known") {
+            std::cerr << "Unknown initial bound '" << bound << "', supported are: none, beam, known\n";
+            std::exit(2);
+        }
+        return std::make_unique<DepthFirstBranchAndBound>(
+            getHeuristic(parser),
+            parser.get<size_t>("--max-depth"),
+            parser.get<size_t>("--tt-size"),
+            std::chrono::milliseconds(parser.get<int>("--time-limit")),
+            std::move(initial)
+        );
+    } else if (solver_name == "bidir") {
+        return std::make_unique<BidirectionalSearch>(parser.get<size_t>("--max-states"), parser.get<int>("--max-taken"));
+    } else if (solver_name == "perimeter") {
+        return std::make_unique<PerimeterSearch>(
+            getHeuristic(parser),
+            parser.get<int>("--perimeter-depth"),
+            parser.get<size_t>("--perimeter-states"),
+            parser.get<int>("--max-taken")
+        );
     } else if (solver_name == "bfs") {
 	    return std::make_unique<BreadthFirstSearch>(parser.get<size_t>("--mem-limit"));
     } else if (solver_name == "dfs") {
@@ -79,11 +317,31 @@ std::unique_ptr<SearchStrategyItf> getSolver(const argparse::ArgumentParser &par
         return std::make_unique<AStarSearch>(getHeuristic(parser), parser.get<size_t>("--mem-limit"));
     } else {
         std::cerr << "Unknown solver name '" << solver_name << "'\n";
-        std::cerr << "Supported are: dummy, bfs, a_star, dfs\n";
+        std::cerr << "Supported are: dummy, nmcs, beam, anytime_a_star, dfbnb, bidir, perimeter, bfs, a_star, dfs\n";
         std::exit(2);
     }
 }
 
+// The options which change what the solver makes of a deal, keying the solution cache.
+// Left out are the ones choosing the deals, spreading the work or only changing
+// how a solution is counted, as well as the paths of the databases: the pattern
+// database is the same whatever the options, and an endgame database is only
+// opened for the --endgame-cards, --supermoves and --autoplay it was built for.
+std::string solverConfig(const argparse::ArgumentParser &parser) {
+    std::ostringstream config;
+    for (auto name : {"--solver", "--heuristic", "--autoplay", "--prune", "--dfbnb-bound"})
+        config << name << "=" << parser.get<std::string>(name) << ";";
+    for (auto name : {"--max-depth", "--attempts", "--beam-width", "--tt-size", "--max-states", "--perimeter-states", "--mem-limit"})
+        config << name << "=" << parser.get<size_t>(name) << ";";
+    for (auto name : {"--time-limit", "--level", "--max-taken", "--perimeter-depth", "--dls-limit"})
+        config << name << "=" << parser.get<int>(name) << ";";
+    for (auto name : {"--weight", "--weight-step"})
+        config << name << "=" << parser.get<double>(name) << ";";
+    config << "--supermoves=" << parser.get<bool>("--supermoves") << ";";
+    if (parser.is_used("--endgame-db"))
+        config << "--endgame-cards=" << parser.get<int>("--endgame-cards") << ";";
+    return config.str();
+}
 
 int main(int argc, const char *argv[]) {
     argparse::ArgumentParser parser("FreeCell@SUI");
@@ -93,8 +351,40 @@ int main(int argc, const char *argv[]) {
     parser.add_argument("--easy-mode").default_value(-1).scan<'d', int>();
     parser.add_argument("--solver").default_value(std::string("dummy"));
     parser.add_argument("--heuristic").default_value(std::string("nb_not_home"));
+    parser.add_argument("--max-depth").default_value(std::size_t{500}).scan<'u', size_t>();
+    parser.add_argument("--attempts").default_value(std::size_t{5}).scan<'u', size_t>();
+    parser.add_argument("--threads").default_value(std::size_t{1}).scan<'u', size_t>();
+    parser.add_argument("--beam-width").default_value(std::size_t{100}).scan<'u', size_t>();
+    parser.add_argument("--weight").default_value(5.0).scan<'g', double>();
+    parser.add_argument("--weight-step").default_value(1.0).scan<'g', double>();
+    parser.add_argument("--time-limit").default_value(0).scan<'d', int>();
+    parser.add_argument("--level").default_value(1).scan<'d', int>();
+    parser.add_argument("--pdb-file").default_value(std::string("fc-sui.pdb"));
+    parser.add_argument("--supermoves").default_value(false).implicit_value(true);
+    parser.add_argument("--expand-supermoves").default_value(false).implicit_value(true);
+    parser.add_argument("--autoplay").default_value(std::string("conservative"));
+    parser.add_argument("--prune").default_value(std::string("none"));
+    parser.add_argument("--dfbnb-bound").default_value(std::string("none"));
+    parser.add_argument("--tt-size").default_value(std::size_t{0}).scan<'u', size_t>();
+    parser.add_argument("--max-states").default_value(std::size_t{2'000'000}).scan<'u', size_t>();
+    parser.add_argument("--max-taken").default_value(2).scan<'d', int>();
+    parser.add_argument("--perimeter-depth").default_value(2).scan<'d', int>();
+    parser.add_argument("--perimeter-states").default_value(std::size_t{200'000}).scan<'u', size_t>();
     parser.add_argument("--dls-limit").default_value(1'000'000).scan<'d', int>();
     parser.add_argument("--mem-limit").default_value(std::size_t{2'147'483'648}).scan<'u', size_t>();
+    parser.add_argument("--endgame-db");
+    parser.add_argument("--endgame-cards").default_value(5).scan<'d', int>();
+    parser.add_argument("--solution-cache");
+    parser.add_argument("--no-cache").default_value(false).implicit_value(true);
+    parser.add_argument("--refresh-cache").default_value(false).implicit_value(true);
+    parser.add_argument("--deals");
+    parser.add_argument("--corpus");
+    parser.add_argument("--verify-corpus").default_value(false).implicit_value(true);
+    parser.add_argument("--dump-corpus");
+    parser.add_argument("--text-deals");
+    parser.add_argument("--dump-text");
+    parser.add_argument("--gen-threads").default_value(std::size_t{0}).scan<'u', size_t>();
+    parser.add_argument("--jobs").default_value(std::size_t{1}).scan<'u', size_t>();
 
     try {
         parser.parse_args(argc, argv);
@@ -104,6 +394,44 @@ int main(int argc, const char *argv[]) {
         std::exit(2);
     }
 
+    // the deal files are only read here, so that a bad one is reported before solving
+    std::unique_ptr<InitialStateProducerItf> producer;
+    int nb_games;
+    try {
+        producer = getProducer(parser);
+        nb_games = getNbGames(parser);
+    } catch (const std::exception &err) {
+        std::cerr << err.what() << "\n";
+        std::exit(2);
+    }
+
+    // the deal generator threads make the indexed deals, so they are dealt
+    // everywhere else too, for the same deals with or without --gen-threads
+    IndexedProducer indexed(*producer);
+    InitialStateProducerItf &deals = producer->supportsIndexed() ? indexed : *producer;
+
+    if (parser.is_used("--dump-corpus") || parser.is_used("--dump-text")) {
+        try {
+            if (parser.is_used("--dump-corpus")) {
+                writeDealCorpus(parser.get<std::string>("--dump-corpus"), deals, nb_games);
+                return 0;
+            }
+
+            auto path = parser.get<std::string>("--dump-text");
+            std::ofstream out(path);
+            for (int i = 0; i < nb_games; ++i)
+                writeTextDeal(out, deals.produce());
+            if (!out) {
+                std::cerr << "Failed writing deals to '" << path << "'\n";
+                return 1;
+            }
+        } catch (const std::exception &err) {
+            std::cerr << err.what() << "\n";
+            std::exit(2);
+        }
+        return 0;
+    }
+
     StrategyEvaluation evaluation_record;
 
     MemWatcher mem_watcher(
@@ -113,18 +441,105 @@ int main(int argc, const char *argv[]) {
     );
     std::thread thread_mem_watch(&MemWatcher::run, &mem_watcher);
 
-    std::unique_ptr<InitialStateProducerItf> producer = getProducer(parser);
-    std::unique_ptr<SearchStrategyItf> search_strategy = getSolver(parser);
+    SearchState::enableSupermoves(parser.get<bool>("--supermoves"));
+    auto expand_supermoves = parser.get<bool>("--expand-supermoves");
+    auto bound_by_known = parser.get<std::string>("--dfbnb-bound") == "known";
+    setPruning(parser);
+    SearchState::setAutoplay(getAutoplay(parser));
+    if (parser.is_used("--endgame-db")) {
+        try {
+            SearchState::setEndgameDatabase(EndgameDatabase::open(
+                parser.get<std::string>("--endgame-db"),
+                parser.get<int>("--endgame-cards")
+            ));
+        } catch (const std::exception &err) {
+            std::cerr << err.what() << "\n";
+            std::exit(2);
+        }
+    }
 
-    auto nb_games = parser.get<int>("nb_games");
-    for (int i = 0; i < nb_games; ++i) {
-        GameState gs = producer->produce();
-        SearchState init_state(gs);
-        eval_strategy(search_strategy, init_state, &evaluation_record);
+    std::unique_ptr<SolutionCache> cache;
+    if (parser.is_used("--solution-cache") && !parser.get<bool>("--no-cache")) {
+        try {
+            cache = std::make_unique<SolutionCache>(parser.get<std::string>("--solution-cache"), solverConfig(parser));
+        } catch (const std::exception &err) {
+            std::cerr << err.what() << "\n";
+            std::exit(2);
+        }
+    }
+    auto refresh_cache = parser.get<bool>("--refresh-cache");
+
+    auto nb_gen_threads = parser.get<size_t>("--gen-threads");
+    auto nb_jobs = std::max<size_t>(parser.get<size_t>("--jobs"), 1);
+
+    // deals are either made ahead by the pipeline or inline by whichever job needs one
+    std::unique_ptr<DealPipeline> pipeline;
+    if (nb_gen_threads > 0) {
+        pipeline = std::make_unique<DealPipeline>(*producer, std::max(nb_games, 0), nb_gen_threads, 4 * nb_jobs);
     }
+    std::mutex deals_mutex;
+    int nb_dealt = 0;
+    // the first error of any job, the others stop at their next deal
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};
+    auto next_deal = [&]() -> std::optional<Deal> {
+        if (failed)
+            return std::nullopt;
+        if (pipeline)
+            return pipeline->pop();
+        std::lock_guard<std::mutex> lock(deals_mutex);
+        if (nb_dealt >= nb_games)
+            return std::nullopt;
+        nb_dealt++;
+        return deals.produceDeal();
+    };
+
+    std::mutex report_mutex;
+    auto run_job = [&] {
+        try {
+            std::unique_ptr<SearchStrategyItf> search_strategy = getSolver(parser);
+            while (auto deal = next_deal()) {
+                StrategyEvaluation game_record;
+                eval_strategy(search_strategy, *deal, expand_supermoves, bound_by_known, cache.get(), refresh_cache, &game_record);
+                std::lock_guard<std::mutex> lock(report_mutex);
+                evaluation_record += game_record;
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(report_mutex);
+            if (!error)
+                error = std::current_exception();
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> jobs;
+    for (size_t i = 1; i < nb_jobs; ++i)
+        jobs.emplace_back(run_job);
+    run_job();
+    for (auto &job : jobs)
+        job.join();
 
     mem_watcher.kill();
     thread_mem_watch.join();
 
+    if (error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const std::exception &err) {
+            std::cerr << err.what() << "\n";
+            std::exit(2);
+        }
+    }
+
     std::cout << evaluation_record;
+
+    if (MovePruning::anyEnabled()) {
+        std::cout << "Pruned actions:";
+        for (int i = 0; i < nb_pruning_rules; ++i) {
+            auto rule = MovePruning::rule(i);
+            if (MovePruning::enabled(rule))
+                std::cout << " " << MovePruning::name(rule) << " " << MovePruning::nbPruned(rule);
+        }
+        std::cout << "\n";
+    }
 }
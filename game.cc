@@ -3,10 +3,17 @@
 
 #include <algorithm>
 #include <cassert>
+#include <functional>
 #include <random>
+#include <stdexcept>
+#include <string>
 
 #include <tuple>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 template <typename In>
 std::vector<CardStorage *> collect_location_pointers(In begin, In end) {
     std::vector<CardStorage *> adresses;
@@ -34,23 +41,63 @@ void GameState::recalculatePointerArrays_(void) {
 
     for (int i=0; i<nb_homes; ++i)
         all_storage[i + nb_freecells + nb_stacks] = &homes[i];
+
+    for (size_t i = 0; i < all_storage.size(); ++i)
+        all_storage[i]->attachIndex(&index, i);
+}
+
+void GameState::reindex(void) {
+    index.clear();
+    for (size_t i = 0; i < nb_freecells; ++i) {
+        auto opt_card = free_cells[i].topCard();
+        if (opt_card.has_value())
+            index.place(*opt_card, i, 0);
+    }
+
+    for (size_t i = 0; i < nb_stacks; ++i) {
+        const auto &cards = stacks[i].storage();
+        for (size_t depth = 0; depth < cards.size(); ++depth)
+            index.place(cards[depth], i + nb_freecells, depth);
+    }
+
+    for (size_t i = 0; i < nb_homes; ++i) {
+        auto opt_top = homes[i].topCard();
+        if (!opt_top.has_value())
+            continue;
+        for (int value = 1; value <= opt_top->value; ++value)
+            index.placeHome({opt_top->color, value}, i + nb_freecells + nb_stacks);
+    }
+}
+
+size_t GameState::nbCardsAbove(const Card &card) const {
+    auto slot = slotOf(card);
+    if (slot == CardIndex::nowhere || slot < nb_freecells)
+        return 0;
+    else if (slot < nb_freecells + nb_stacks)
+        return stacks[slot - nb_freecells].nbCards() - depthOf(card) - 1;
+    else
+        return homeValue(card.color) - card.value;
 }
 
 GameState::GameState(const GameState &other) :
         homes(other.homes),
         free_cells(other.free_cells),
-        stacks(other.stacks) 
+        stacks(other.stacks),
+        index(other.index)
     {
     recalculatePointerArrays_();
 }
 
 GameState& GameState::operator=(GameState &&other) {
+    // `other` is left holding the former contents, with an index to match
     std::swap(homes, other.homes);
     std::swap(stacks, other.stacks);
-
-    for (size_t i = 0; i < nb_freecells; ++i)
+    for (size_t i = 0; i < nb_freecells; ++i) {
+        FreeCell cell(free_cells[i]);
         free_cells[i] = other.free_cells[i];
-
+        other.free_cells[i] = cell;
+    }
+    std::swap(index, other.index);
     recalculatePointerArrays_();
     
     return *this;
@@ -68,6 +115,35 @@ bool operator==(const GameState &lhs, const GameState &rhs) {
     return lhs_tuple == rhs_tuple;
 }
 
+namespace {
+
+void hashCombine(size_t &seed, size_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+size_t cardHash(const std::optional<Card> &card) {
+    if (!card.has_value())
+        return 0;
+    return static_cast<size_t>(card->color) * king_value + card->value;
+}
+
+}
+
+size_t std::hash<GameState>::operator()(const GameState &state) const {
+    size_t seed = 0;
+    for (const auto &home : state.homes)
+        hashCombine(seed, cardHash(home.topCard()));
+    for (const auto &fc : state.free_cells)
+        hashCombine(seed, cardHash(fc.topCard()));
+    for (const auto &stack : state.stacks) {
+        hashCombine(seed, stack.nbCards());
+        for (const auto &card : stack.storage())
+            hashCombine(seed, cardHash(card));
+    }
+
+    return seed;
+}
+
 std::vector<Card> topCards(const GameState &gs) {
     std::vector<Card> cards;
 
@@ -80,7 +156,11 @@ std::vector<Card> topCards(const GameState &gs) {
     return cards;
 }
 
-int moveCardsFromHomes(GameState *gs, int max_nb_cards, size_t stack_begin, size_t stack_end, std::default_random_engine rng) {
+std::uint8_t slotOfPtr(const GameState &gs, const CardStorage *ptr) {
+    return std::find(gs.all_storage.begin(), gs.all_storage.end(), ptr) - gs.all_storage.begin();
+}
+
+int moveCardsFromHomes(GameState *gs, int max_nb_cards, size_t stack_begin, size_t stack_end, std::default_random_engine rng, std::vector<SlotMove> *reverse_moves) {
     int nb_cards_moved = 0;
     for (; nb_cards_moved < max_nb_cards; ++nb_cards_moved) {
         std::vector<CardStorage *> considered_froms{&gs->homes[nb_cards_moved % gs->homes.size()]};
@@ -97,6 +177,8 @@ int moveCardsFromHomes(GameState *gs, int max_nb_cards, size_t stack_begin, size
             break;
 
         int pick = std::uniform_int_distribution<std::mt19937::result_type>(0, moves.size()-1)(rng);
+        if (reverse_moves)
+            reverse_moves->push_back({slotOfPtr(*gs, moves[pick].first), slotOfPtr(*gs, moves[pick].second)});
         // we have a non-const access to GameState (gs), so we are allowed to de-const the pointers in RawMove
         move(const_cast<CardStorage *>(moves[pick].first), const_cast<CardStorage *>(moves[pick].second));
     }
@@ -157,6 +239,13 @@ bool operator!= (const Location &lhs, const Location &rhs) {
     return !(lhs == rhs);
 }
 
+int MoveTrail::nbToHomes() const {
+    int nb = 0;
+    for (int i = 0; i < size; ++i)
+        nb += steps[i].to.cl == LocationClass::Homes;
+    return nb;
+}
+
 // to be used only with continuous-storage containers
 template<typename T>
 bool isInContainer(const CardStorage *ptr, const T& container) {
@@ -181,14 +270,200 @@ Location locFromPtr(const GameState &gs, const CardStorage *ptr) {
         throw std::out_of_range("Pointer doesn't match any of homes, freecells or stacks in the given GameState");
 }
 
-void initializeGameState(GameState *gs, std::default_random_engine &rng) {
+Location locFromSlot(std::size_t slot) {
+    if (slot < nb_freecells)
+        return {LocationClass::FreeCells, static_cast<long>(slot)};
+    else if (slot < nb_freecells + nb_stacks)
+        return {LocationClass::Stacks, static_cast<long>(slot - nb_freecells)};
+    else
+        return {LocationClass::Homes, static_cast<long>(slot - nb_freecells - nb_stacks)};
+}
+
+std::size_t slotFromLoc(const Location &loc) {
+    switch (loc.cl) {
+    case LocationClass::FreeCells:
+        return loc.id;
+    case LocationClass::Stacks:
+        return nb_freecells + loc.id;
+    default:
+        return nb_freecells + nb_stacks + loc.id;
+    }
+}
+
+namespace {
+
+// for every card, the mask of the (at most two) cards it can sit on in a stack
+const std::array<std::uint64_t, CardIndex::nb_cards> &stackBases() {
+    static const auto bases = [] {
+        std::array<std::uint64_t, CardIndex::nb_cards> table{};
+        for (auto color : colors_list) {
+            for (int value = 1; value < king_value; ++value) {
+                for (auto base_color : colors_list) {
+                    if (WorkStack::canSitOn({base_color, value + 1}, {color, value}))
+                        table[CardIndex::id({color, value})] |= std::uint64_t{1} << CardIndex::id({base_color, value + 1});
+                }
+            }
+        }
+        return table;
+    }();
+    return bases;
+}
+
+// index of the lowest set bit, `mask` must not be 0
+inline int lowestBit(std::uint64_t mask) {
+    assert(mask != 0);
+#if defined(_MSC_VER)
+    // _BitScanForward64 is missing on 32-bit targets, scan the halves
+    unsigned long bit;
+    if (_BitScanForward(&bit, static_cast<unsigned long>(mask)))
+        return bit;
+    _BitScanForward(&bit, static_cast<unsigned long>(mask >> 32));
+    return bit + 32;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+} // namespace
+
+int legalMoves(const GameState &gs, SlotMoveBuffer &moves) {
+    constexpr int first_stack = nb_freecells;
+    constexpr int first_home = nb_freecells + nb_stacks;
+    const auto &index = gs.index;
+    const auto &bases = stackBases();
+
+    // empty cells and stacks take any card, empty homes any ace
+    std::uint32_t empty_targets = 0;
+    std::uint32_t empty_homes = 0;
+    for (int slot = 0; slot < CardIndex::nb_slots; ++slot) {
+        if (index.top[slot] == CardIndex::nowhere)
+            (slot < first_home ? empty_targets : empty_homes) |= 1u << slot;
+    }
+
+    int nb_moves = 0;
+    for (int from = 0; from < first_home; ++from) {
+        int card = index.top[from];
+        if (card == CardIndex::nowhere)
+            continue;
+
+        std::uint32_t targets = empty_targets;
+
+        for (std::uint64_t base_mask = bases[card]; base_mask != 0; base_mask &= base_mask - 1) {
+            int base = lowestBit(base_mask);
+            int base_slot = index.slot[base];
+            if (base_slot >= first_stack && base_slot < first_home && index.top[base_slot] == base)
+                targets |= 1u << base_slot;
+        }
+
+        int color = card / king_value;
+        int value = card % king_value + 1;
+        if (value == 1)
+            targets |= empty_homes;
+        else if (index.home_value[color] == value - 1)
+            targets |= 1u << index.home_slot[color];
+
+        for (; targets != 0; targets &= targets - 1)
+            moves[nb_moves++] = {static_cast<std::uint8_t>(from), static_cast<std::uint8_t>(lowestBit(targets))};
+    }
+
+    return nb_moves;
+}
+
+int reverseMoves(const GameState &gs, SlotMoveBuffer &moves) {
+    constexpr int first_stack = nb_freecells;
+    constexpr int first_home = nb_freecells + nb_stacks;
+
+    // free cells are interchangeable, a card goes back to the first empty one
+    int empty_cell = -1;
+    for (int slot = 0; slot < nb_freecells && empty_cell < 0; ++slot) {
+        if (!gs.free_cells[slot].topCard().has_value())
+            empty_cell = slot;
+    }
+
+    int nb_moves = 0;
+    for (int to = 0; to < CardIndex::nb_slots; ++to) {
+        if (!gs.all_storage[to]->topCard().has_value())
+            continue;
+
+        if (to >= first_stack && to < first_home) {
+            const auto &cards = gs.stacks[to - first_stack].storage();
+            if (cards.size() >= 2 && !WorkStack::canSitOn(cards[cards.size() - 2], cards.back()))
+                continue;
+        }
+
+        if (empty_cell >= 0 && to >= first_stack)
+            moves[nb_moves++] = {static_cast<std::uint8_t>(empty_cell), static_cast<std::uint8_t>(to)};
+        for (int from = first_stack; from < first_home; ++from) {
+            if (from != to)
+                moves[nb_moves++] = {static_cast<std::uint8_t>(from), static_cast<std::uint8_t>(to)};
+        }
+    }
+
+    return nb_moves;
+}
+
+void unplayMove(GameState *gs, SlotMove move) {
+    auto card = gs->all_storage[move.to]->getCard();
+    auto origin = gs->all_storage[move.from];
+    if (auto stack = dynamic_cast<WorkStack *>(origin))
+        stack->forceCard(*card);
+    else
+        origin->acceptCard(*card);
+}
+
+std::string canonicalKey(const GameState &gs) {
+    constexpr char separator = static_cast<char>(CardIndex::nowhere);
+
+    std::string key;
+    key.reserve(nb_homes + nb_freecells + CardIndex::nb_cards + nb_stacks);
+    for (auto color : colors_list)
+        key.push_back(static_cast<char>(gs.homeValue(color)));
+
+    std::array<std::uint8_t, nb_freecells> cells;
+    for (int i = 0; i < nb_freecells; ++i) {
+        auto card = gs.free_cells[i].topCard();
+        cells[i] = card.has_value() ? CardIndex::id(*card) : CardIndex::nowhere;
+    }
+    std::sort(cells.begin(), cells.end());
+    for (auto cell : cells)
+        key.push_back(static_cast<char>(cell));
+
+    for (const auto &stack : gs.stacks) {
+        for (const auto &card : stack.storage())
+            key.push_back(static_cast<char>(CardIndex::id(card)));
+        key.push_back(separator);
+    }
+
+    return key;
+}
+
+void initializeGameState(GameState *gs, std::default_random_engine &rng, std::vector<SlotMove> *reverse_moves) {
     for (size_t i=0; i<colors_list.size(); ++i) {
         for (int j=1; j <= king_value; ++j)
             gs->homes[i].acceptCard({colors_list[i], j});
     }
 
-    moveCardsFromHomes(gs, 20, 0, 5, rng);
-    moveCardsFromHomes(gs, 32, 0, 8, rng);
+    moveCardsFromHomes(gs, 20, 0, 5, rng, reverse_moves);
+    moveCardsFromHomes(gs, 32, 0, 8, rng, reverse_moves);
+}
+
+bool isSolution(const GameState &gs, const std::vector<SlotMove> &moves) {
+    GameState played(gs);
+    for (const auto &move : moves) {
+        if (move.from >= played.all_storage.size() || move.to >= played.all_storage.size())
+            return false;
+        auto from = played.all_storage[move.from];
+        auto to = played.all_storage[move.to];
+        if (!moveLegal(from, to))
+            return false;
+        ::move(from, to);
+    }
+
+    for (auto color : colors_list) {
+        if (played.homeValue(color) != king_value)
+            return false;
+    }
+    return true;
 }
 
 std::optional<std::pair<CardStorage *, WorkStack *>> findIrreversibleMove(GameState *gs, std::default_random_engine &rng) {
@@ -230,24 +505,28 @@ std::optional<std::pair<CardStorage *, WorkStack *>> findIrreversibleMove(GameSt
 }
 
 auto findHomeFor(const GameState &gs, Card card) -> decltype(gs.homes)::const_iterator {
-    return std::find_if(
-        gs.homes.begin(),
-        gs.homes.end(),
-        [&](const CardStorage &cs){return cs.canAccept(card);}
-    );
+    constexpr int first_home_slot = nb_freecells + nb_stacks;
+
+    if (card.value == 1) {
+        // aces take the first empty home
+        std::array<bool, nb_homes> taken{};
+        for (int slot : gs.index.home_slot) {
+            if (slot >= 0)
+                taken[slot - first_home_slot] = true;
+        }
+        auto free_home = std::find(taken.begin(), taken.end(), false);
+        if (gs.homeValue(card.color) > 0 || free_home == taken.end())
+            return gs.homes.end();
+        return gs.homes.begin() + (free_home - taken.begin());
+    }
+
+    if (gs.homeValue(card.color) != card.value - 1)
+        return gs.homes.end();
+    return gs.homes.begin() + (gs.index.home_slot[static_cast<int>(card.color)] - first_home_slot);
 }
 
 bool cardIsHome(const GameState &gs, Card card) {
-    for (const auto & home : gs.homes) {
-        auto opt_top_card = home.topCard();
-        if (!opt_top_card.has_value())
-            continue;
-
-        if (opt_top_card->color == card.color && opt_top_card->value >= card.value)
-            return true;
-    }
-
-    return false;
+    return gs.homeValue(card.color) >= card.value;
 }
 
 bool cardCouldGoHome(const GameState &gs, Card card) {
@@ -258,7 +537,6 @@ bool cardCouldGoHome(const GameState &gs, Card card) {
         return true;
 
     auto render_color{render_color_map.at(card.color)}; 
-    std::vector<Color> opposite_rc_colors;
     bool safe = true;
 
     for (auto & color : colors_list) {
@@ -289,6 +567,128 @@ std::vector<RawMove> safeHomeMoves(const GameState &gs) {
     return moves;
 }
 
+bool autoplaySafe(Color color, int value, const std::array<int, 4> &home_values, AutoplayMode mode) {
+    if (value <= 2)
+        return true;
+
+    auto render_color = render_color_map.at(color);
+    int opposite_min = king_value;
+    int other_same = king_value;
+    for (auto other : colors_list) {
+        int home_value = home_values[static_cast<int>(other)];
+        if (render_color_map.at(other) != render_color)
+            opposite_min = std::min(opposite_min, home_value);
+        else if (other != color)
+            other_same = home_value;
+    }
+
+    if (opposite_min >= value - 1)
+        return true;
+
+    return mode == AutoplayMode::Aggressive && opposite_min >= value - 2 && other_same >= value - 3;
+}
+
+bool isWonEndgame(const GameState &gs) {
+    for (const auto &stack : gs.stacks) {
+        const auto &cards = stack.storage();
+        for (size_t i = 1; i < cards.size(); ++i) {
+            if (cards[i].value >= cards[i - 1].value)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+size_t orderedRunLength(const WorkStack &stack) {
+    const auto &cards = stack.storage();
+    if (cards.empty())
+        return 0;
+
+    size_t length = 1;
+    while (length < cards.size() && WorkStack::canSitOn(cards[cards.size() - length - 1], cards[cards.size() - length]))
+        length++;
+
+    return length;
+}
+
+size_t supermoveCapacity(const GameState &gs, const WorkStack *to) {
+    size_t nb_free_cells = 0;
+    for (const auto &fc : gs.free_cells)
+        nb_free_cells += !fc.topCard().has_value();
+
+    size_t capacity = nb_free_cells + 1;
+    for (const auto &stack : gs.stacks) {
+        if (&stack != to && stack.nbCards() == 0)
+            capacity *= 2;
+    }
+
+    return capacity;
+}
+
+bool supermoveLegal(const GameState &gs, const WorkStack *from, const WorkStack *to, size_t nb_cards) {
+    if (from == to || nb_cards > orderedRunLength(*from) || nb_cards > supermoveCapacity(gs, to))
+        return false;
+
+    const auto &cards = from->storage();
+    return to->canAccept(cards[cards.size() - nb_cards]);
+}
+
+void supermove(WorkStack *from, WorkStack *to, size_t nb_cards) {
+    std::vector<Card> run;
+    for (size_t i = 0; i < nb_cards; ++i)
+        run.push_back(*from->getCard());
+
+    for (auto it = run.rbegin(); it != run.rend(); ++it)
+        to->acceptCard(*it);
+}
+
+std::vector<MoveTrail::Step> planSupermove(const GameState &gs, Location from, Location to, size_t nb_cards) {
+    const auto &cards = gs.stacks[from.id].storage();
+    const Card *run = cards.data() + cards.size() - nb_cards;
+
+    std::vector<Location> cells;
+    for (long i = 0; i < nb_freecells; ++i) {
+        if (!gs.free_cells[i].topCard().has_value())
+            cells.push_back({LocationClass::FreeCells, i});
+    }
+    std::vector<Location> empty_stacks;
+    for (long i = 0; i < nb_stacks; ++i) {
+        if (i != from.id && i != to.id && gs.stacks[i].nbCards() == 0)
+            empty_stacks.push_back({LocationClass::Stacks, i});
+    }
+
+    std::vector<MoveTrail::Step> plan;
+    auto step = [&](size_t card, Location step_from, Location step_to) {
+        plan.push_back({step_from, step_to, run[card].color, run[card].value});
+    };
+
+    // moves run[lo] ... run[hi-1], lying on top of `src`, onto `dst`
+    std::function<void(size_t, size_t, Location, Location, size_t)> move_run;
+    move_run = [&](size_t lo, size_t hi, Location src, Location dst, size_t nb_empty_stacks) {
+        size_t count = hi - lo;
+        if (count <= cells.size() + 1) {
+            for (size_t k = hi - 1; k > lo; --k)
+                step(k, src, cells[hi - 1 - k]);
+            step(lo, src, dst);
+            for (size_t k = lo + 1; k < hi; ++k)
+                step(k, cells[hi - 1 - k], dst);
+            return;
+        }
+
+        // park the upper half in an empty stack, using the rest as for the lower half
+        assert(nb_empty_stacks > 0);
+        Location parking = empty_stacks[nb_empty_stacks - 1];
+        size_t middle = hi - count / 2;
+        move_run(middle, hi, src, parking, nb_empty_stacks - 1);
+        move_run(lo, middle, src, dst, nb_empty_stacks - 1);
+        move_run(middle, hi, parking, dst, nb_empty_stacks - 1);
+    };
+    move_run(0, nb_cards, from, to, empty_stacks.size());
+
+    return plan;
+}
+
 std::ostream& operator<< (std::ostream& os, const GameState & state) {
     os << "Homes: " <<
         state.homes[0] << " " <<
@@ -326,18 +726,103 @@ std::ostream& operator<< (std::ostream& os, const Location & loc) {
     return os;
 }
 
-GameState EasyProducer::produce() {
-    GameState gs;
+GameState InitialStateProducerItf::produceAt(std::uint64_t) const {
+    throw std::logic_error("This producer only makes its deals in order");
+}
+
+namespace {
+
+// Undoes the moves which made the deal, last first, as legal single-card moves.
+// A forced card often cannot go back onto the card it came from; it is then
+// parked in a free cell, from where the following moves take it on.
+std::optional<std::vector<SlotMove>> undoReverseMoves(const GameState &gs, const std::vector<SlotMove> &reverse_moves) {
+    // `exact` undoes the moves as they were made, to tell which card each one moved
+    GameState exact(gs);
+    GameState played(gs);
+    std::vector<SlotMove> solution;
+
+    for (auto it = reverse_moves.rbegin(); it != reverse_moves.rend(); ++it) {
+        auto card = exact.all_storage[it->to]->getCard();
+        auto origin = exact.all_storage[it->from];
+        if (auto stack = dynamic_cast<WorkStack *>(origin))
+            stack->forceCard(*card);
+        else
+            origin->acceptCard(*card);
+
+        std::uint8_t slot = played.slotOf(*card);
+        auto from = played.all_storage[slot];
+        if (from->topCard() != card)
+            return std::nullopt;
+
+        std::uint8_t to_slot = it->from;
+        if (!moveLegal(from, played.all_storage[to_slot])) {
+            if (slot < nb_freecells)
+                continue;
+            auto free_cell = std::find_if(played.free_cells.begin(), played.free_cells.end(),
+                [](const FreeCell &cell){return !cell.topCard().has_value();});
+            if (free_cell == played.free_cells.end())
+                return std::nullopt;
+            to_slot = free_cell - played.free_cells.begin();
+        }
+
+        move(from, played.all_storage[to_slot]);
+        solution.push_back({slot, to_slot});
+    }
+
+    return solution;
+}
+
+std::default_random_engine indexedRng(int seed, std::uint64_t index) {
+    std::seed_seq seq{
+        static_cast<std::uint32_t>(seed),
+        static_cast<std::uint32_t>(index),
+        static_cast<std::uint32_t>(index >> 32)
+    };
+    return std::default_random_engine(seq);
+}
+
+} // namespace
+
+Deal EasyProducer::produce_(std::default_random_engine &rng, int difficulty, bool with_solution) {
+    Deal deal;
+    auto &gs = deal.state;
+    std::vector<SlotMove> reverse_moves;
 
-    initializeGameState(&gs, rng_);
-    for (int i = 0; i < difficulty_; ++i) {
-        auto move = findIrreversibleMove(&gs, rng_);
+    initializeGameState(&gs, rng, &reverse_moves);
+    for (int i = 0; i < difficulty; ++i) {
+        auto move = findIrreversibleMove(&gs, rng);
         if (!move.has_value())
             break;
+        reverse_moves.push_back({slotOfPtr(gs, move->first), slotOfPtr(gs, move->second)});
         forceMove(move->first, move->second); 
     }
 
-    return gs;
+    if (!with_solution)
+        return deal;
+
+    auto solution = undoReverseMoves(gs, reverse_moves);
+    if (solution.has_value() && isSolution(gs, *solution))
+        deal.known_solution = std::move(solution);
+
+    return deal;
+}
+
+GameState EasyProducer::produce() {
+    return produce_(rng_, difficulty_, false).state;
+}
+
+Deal EasyProducer::produceDeal() {
+    return produce_(rng_, difficulty_, true);
+}
+
+GameState EasyProducer::produceAt(std::uint64_t index) const {
+    auto rng = indexedRng(seed_, index);
+    return produce_(rng, difficulty_, false).state;
+}
+
+Deal EasyProducer::produceDealAt(std::uint64_t index) const {
+    auto rng = indexedRng(seed_, index);
+    return produce_(rng, difficulty_, true);
 }
 
 GameState RandomProducer::produce() {
@@ -347,3 +832,45 @@ GameState RandomProducer::produce() {
     return gs;
 }
 
+GameState RandomProducer::produceAt(std::uint64_t index) const {
+    auto rng = indexedRng(seed_, index);
+    GameState gs;
+    initializeFullRandom(&gs, rng);
+
+    return gs;
+}
+
+
+GameState MicrosoftProducer::deal(std::uint32_t number) {
+    // Microsoft's cards are numbered rank by rank, in the suit order club, diamond, heart, spade
+    constexpr std::array<Color, 4> ms_suits{Color::Club, Color::Diamond, Color::Heart, Color::Spade};
+
+    std::uint32_t seed = number;
+    auto rand = [&seed] {
+        seed = (seed * 214013u + 2531011u) & 0x7fffffffu;
+        return seed >> 16;
+    };
+
+    std::array<int, 4 * king_value> deck;
+    for (int i = 0; i < static_cast<int>(deck.size()); ++i)
+        deck[i] = deck.size() - 1 - i;
+
+    for (int i = 0; i < static_cast<int>(deck.size()) - 1; ++i) {
+        int j = deck.size() - 1 - rand() % (deck.size() - i);
+        std::swap(deck[i], deck[j]);
+    }
+
+    // dealt row by row, the first row lying at the bottom of the stacks
+    GameState gs;
+    for (std::size_t i = 0; i < deck.size(); ++i)
+        gs.stacks[i % nb_stacks].forceCard({ms_suits[deck[i] % 4], deck[i] / 4 + 1});
+
+    return gs;
+}
+
+GameState MicrosoftProducer::produce() {
+    if (next_ > last_)
+        throw std::out_of_range("No Microsoft deal left after " + std::to_string(last_));
+
+    return deal(next_++);
+}
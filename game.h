@@ -6,6 +6,7 @@
 
 #include <array>
 #include <random>
+#include <string>
 
 inline constexpr int nb_freecells = 4;
 inline constexpr int nb_homes = 4;
@@ -24,12 +25,30 @@ struct GameState {
     std::array<CardStorage *, nb_stacks+nb_freecells> non_homes;
     std::array<CardStorage *, nb_stacks+nb_freecells+nb_homes> all_storage;
 
+    // kept up to date by the storages themselves
+    CardIndex index;
+    // rebuilds the index from the storages' contents
+    void reindex(void) ;
+
+    // the slot (in all_storage order) and depth of a card, CardIndex::nowhere if absent
+    std::uint8_t slotOf(const Card &card) const {return index.slot[CardIndex::id(card)];}
+    std::uint8_t depthOf(const Card &card) const {return index.depth[CardIndex::id(card)];}
+    int homeValue(Color color) const {return index.home_value[static_cast<int>(color)];}
+    // how many cards lie on top of the card in its storage
+    size_t nbCardsAbove(const Card &card) const ;
+
     void recalculatePointerArrays_(void) ;
 };
 
 bool operator<(const GameState &lhs, const GameState &rhs);
 bool operator==(const GameState &lhs, const GameState &rhs);
 
+namespace std {
+template <> struct hash<GameState> {
+    size_t operator()(const GameState &state) const;
+};
+}
+
 enum class LocationClass {FreeCells, Homes, Stacks};
 struct Location {
 	LocationClass cl;
@@ -41,9 +60,31 @@ bool operator!= (const Location &lhs, const Location &rhs) ;
 
 std::ostream& operator<< (std::ostream& os, const Location & state) ;
 
+// Cards moved by a single search step: the played card first,
+// then the safe home moves it triggered, in the order they were made.
+struct MoveTrail {
+    struct Step {
+        Location from;
+        Location to;
+        Color color;
+        int value;
+    };
+
+    // the played cards (a whole run for a supermove) plus, at most, every card going home
+    static constexpr int capacity = king_value + 4 * king_value;
+
+    std::array<Step, capacity> steps;
+    int size = 0;
+
+    void clear() {size = 0;}
+    void push(Location from, Location to, const Card &card) {
+        steps[size++] = {from, to, card.color, card.value};
+    }
+    int nbToHomes() const;
+};
+
 std::ostream& operator<< (std::ostream& os, const GameState & state) ;
 
-void initializeGameState(GameState *gs, std::default_random_engine &rng) ;
 std::optional<std::pair<CardStorage *, WorkStack *>> findIrreversibleMove(GameState *gs, std::default_random_engine &rng) ;
 
 void initializeFullRandom(GameState *gs, std::default_random_engine &rng) ;
@@ -57,31 +98,146 @@ auto findHomeFor(const GameState &gs, Card card) -> decltype(gs.homes)::const_it
 
 const CardStorage * ptrFromLoc(const GameState &gs, Location const& loc) ;
 Location locFromPtr(const GameState &gs, const CardStorage *ptr) ;
+// location of the storage at all_storage[slot]
+Location locFromSlot(std::size_t slot) ;
+// the other way round, the all_storage slot of `loc`
+std::size_t slotFromLoc(const Location &loc) ;
+
+// Single-card move between all_storage slots.
+struct SlotMove {
+    std::uint8_t from;
+    std::uint8_t to;
+};
+inline constexpr int max_slot_moves = (nb_freecells + nb_stacks) * (nb_freecells + nb_stacks + nb_homes);
+using SlotMoveBuffer = std::array<SlotMove, max_slot_moves>;
+
+// Fills `moves` with the legal single-card moves, in the same order as
+// availableMoves() over non_homes x all_storage, and returns their number.
+// Works on the top cards cached in the index and precomputed per-card masks
+// of the cards it can sit on, without touching the storages.
+int legalMoves(const GameState &gs, SlotMoveBuffer &moves) ;
+
+// Fills `moves` with the single-card moves which could have led to `gs`:
+// the card on top of `to` lies where it was legal to put it, and `from` is
+// another stack or the first empty free cell. Cards on top of the homes are
+// included, as initializeGameState() takes them out. Returns their number.
+int reverseMoves(const GameState &gs, SlotMoveBuffer &moves) ;
+// takes back a move given by reverseMoves()
+void unplayMove(GameState *gs, SlotMove move) ;
+
+// key equal for states which only differ by which free cells hold the cards
+// and which homes the suits took
+std::string canonicalKey(const GameState &gs) ;
+
+// whether the single-card moves, played without any safe moves, are all legal and win the game
+bool isSolution(const GameState &gs, const std::vector<SlotMove> &moves) ;
+
+// deals the cards by moves out of the homes, each recorded into reverse_moves if given
+void initializeGameState(GameState *gs, std::default_random_engine &rng, std::vector<SlotMove> *reverse_moves = nullptr) ;
 
 std::vector<RawMove> safeHomeMoves(const GameState &gs) ;
 
+// How eagerly cards are played home on their own after every move.
+enum class AutoplayMode {
+    // once both opposite-colored cards one lower are home, as cardCouldGoHome()
+    Conservative,
+    // also Horne's rule: once both opposite-colored cards two lower and the
+    // other same-colored card three lower are home; a won endgame is played out at once
+    Aggressive,
+};
+
+// whether a card may go home on its own, home_values being the home tops by color index
+bool autoplaySafe(Color color, int value, const std::array<int, 4> &home_values, AutoplayMode mode) ;
+// every stack is ordered high to low from the bottom, so all cards can just be played home
+bool isWonEndgame(const GameState &gs) ;
+
+// Supermoves: the top nb_cards of a stack, forming an ordered run, moved onto
+// another stack at once. This stands for a series of single-card moves
+// through the empty free cells and stacks, which bounds the run length
+// to (empty free cells + 1) * 2^(empty stacks other than the target).
+size_t orderedRunLength(const WorkStack &stack) ;
+size_t supermoveCapacity(const GameState &gs, const WorkStack *to) ;
+bool supermoveLegal(const GameState &gs, const WorkStack *from, const WorkStack *to, size_t nb_cards) ;
+void supermove(WorkStack *from, WorkStack *to, size_t nb_cards) ;
+// the single-card moves a legal supermove stands for, safe moves not included
+std::vector<MoveTrail::Step> planSupermove(const GameState &gs, Location from, Location to, size_t nb_cards) ;
+
+// A deal, with a solution of it if the producer knows one.
+struct Deal {
+    GameState state;
+    // single-card moves as for isSolution()
+    std::optional<std::vector<SlotMove>> known_solution;
+};
+
 class InitialStateProducerItf {
 public:
     virtual GameState produce() =0;
     virtual ~InitialStateProducerItf() {};
+
+    // the next deal along with its known solution, by default none
+    virtual Deal produceDeal() {return {produce(), std::nullopt};}
+
+    // Producers supporting it can also make their index-th deal on its own,
+    // from any thread at once, regardless of the deals made before.
+    // That deal need not be the one produce() would give.
+    virtual bool supportsIndexed() const {return false;}
+    virtual GameState produceAt(std::uint64_t index) const ;
+    virtual Deal produceDealAt(std::uint64_t index) const {return {produceAt(index), std::nullopt};}
 };
 
 class RandomProducer : public InitialStateProducerItf {
 public:
-    RandomProducer(int seed) : rng_(seed) {}
+    RandomProducer(int seed) : seed_(seed), rng_(seed) {}
     GameState produce() override;
+
+    // dealt from a random stream of its own, seeded by (seed, index)
+    bool supportsIndexed() const override {return true;}
+    GameState produceAt(std::uint64_t index) const override;
 private:
+    int seed_;
     std::default_random_engine rng_;
 };
 
+// Deals made by moving cards out of the homes and then forcing up to `difficulty`
+// cards onto other stacks. Undoing these moves solves the deal, so that is
+// given as its known solution whenever all of them are legal moves.
 class EasyProducer : public InitialStateProducerItf {
 public:
-    EasyProducer(int seed, int difficulty) : rng_(seed), difficulty_(difficulty) {}
+    EasyProducer(int seed, int difficulty) : seed_(seed), rng_(seed), difficulty_(difficulty) {}
     GameState produce() override;
+    Deal produceDeal() override;
+
+    // dealt from a random stream of its own, seeded by (seed, index)
+    bool supportsIndexed() const override {return true;}
+    GameState produceAt(std::uint64_t index) const override;
+    Deal produceDealAt(std::uint64_t index) const override;
 private:
+    // the known solution is only worked out when asked for
+    static Deal produce_(std::default_random_engine &rng, int difficulty, bool with_solution);
+
+    int seed_;
     std::default_random_engine rng_;
     int difficulty_;
 };
 
+// The numbered deals of Microsoft FreeCell, shuffled by the LCG of its C runtime.
+// The solver literature benchmarks on deals 1 to 32000.
+class MicrosoftProducer : public InitialStateProducerItf {
+public:
+    // produces the deals first..last in order
+    MicrosoftProducer(std::uint32_t first, std::uint32_t last) : first_(first), next_(first), last_(last) {}
+    GameState produce() override;
+
+    bool supportsIndexed() const override {return true;}
+    GameState produceAt(std::uint64_t index) const override {return deal(first_ + index);}
+
+    static GameState deal(std::uint32_t number);
+
+private:
+    std::uint32_t first_;
+    std::uint64_t next_;
+    std::uint64_t last_;
+};
+
 
 #endif
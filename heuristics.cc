@@ -0,0 +1,120 @@
+#include "search-strategies.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// counts the blocked cards of one stack, fed from the bottom up
+class BlockedCounter {
+public:
+    BlockedCounter() {lowest_.fill(king_value + 1);}
+
+    void push(Color color, int value) {
+        int &lowest = lowest_[static_cast<int>(color)];
+        if (lowest < value)
+            nb_blocked_++;
+        else
+            lowest = value;
+    }
+
+    int nbBlocked() const {return nb_blocked_;}
+
+private:
+    std::array<int, 4> lowest_;
+    int nb_blocked_ = 0;
+};
+
+int nbBlocked(const WorkStack &stack) {
+    BlockedCounter counter;
+    for (const auto &card : stack.storage())
+        counter.push(card.color, card.value);
+    return counter.nbBlocked();
+}
+
+// the stack as it was before the trail was played
+int nbBlockedBefore(const WorkStack &stack, long stack_id, const MoveTrail &trail) {
+    struct Entry {
+        Color color;
+        int value;
+    };
+    std::array<Entry, 4 * king_value> cards;
+    int height = 0;
+    for (const auto &card : stack.storage())
+        cards[height++] = {card.color, card.value};
+
+    const Location here{LocationClass::Stacks, stack_id};
+    for (int i = trail.size - 1; i >= 0; --i) {
+        const auto &step = trail.steps[i];
+        if (step.to == here)
+            height--;
+        if (step.from == here)
+            cards[height++] = {step.color, step.value};
+    }
+
+    BlockedCounter counter;
+    for (int i = 0; i < height; ++i)
+        counter.push(cards[i].color, cards[i].value);
+    return counter.nbBlocked();
+}
+
+} // namespace
+
+double BlockedCardsHeuristic::distanceLowerBound(const GameState &state) const {
+    int nb_blocked = 0;
+    for (const auto &stack : state.stacks)
+        nb_blocked += nbBlocked(stack);
+
+    return nb_blocked;
+}
+
+double BlockedCardsHeuristic::distanceLowerBoundAfter(double parent_bound, const GameState &state, const MoveTrail &trail) const {
+    // only the stacks the trail touched can change, and only those get rescanned
+    std::array<bool, nb_stacks> touched{};
+    for (int i = 0; i < trail.size; ++i) {
+        const auto &step = trail.steps[i];
+        if (step.from.cl == LocationClass::Stacks)
+            touched[step.from.id] = true;
+        if (step.to.cl == LocationClass::Stacks)
+            touched[step.to.id] = true;
+    }
+
+    double bound = parent_bound;
+    for (int i = 0; i < nb_stacks; ++i) {
+        if (touched[i])
+            bound += nbBlocked(state.stacks[i]) - nbBlockedBefore(state.stacks[i], i, trail);
+    }
+
+    return bound;
+}
+
+MaxHeuristic::MaxHeuristic(std::vector<std::unique_ptr<AStarHeuristicItf>> &&components) :
+        components_(std::move(components)) {
+    std::stable_sort(
+        components_.begin(),
+        components_.end(),
+        [](const auto &a, const auto &b){return a->evaluationCost() < b->evaluationCost();}
+    );
+}
+
+double MaxHeuristic::distanceLowerBound(const GameState &state) const {
+    return distanceLowerBoundCutoff(state, std::numeric_limits<double>::infinity());
+}
+
+double MaxHeuristic::distanceLowerBoundCutoff(const GameState &state, double cutoff) const {
+    double bound = 0;
+    for (const auto &component : components_) {
+        bound = std::max(bound, component->distanceLowerBoundCutoff(state, cutoff));
+        if (bound >= cutoff)
+            break;
+    }
+
+    return bound;
+}
+
+int MaxHeuristic::evaluationCost() const {
+    int cost = 0;
+    for (const auto &component : components_)
+        cost += component->evaluationCost();
+    return cost;
+}
@@ -0,0 +1,140 @@
+#include "mapped-file.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <iterator>
+#include <process.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Cannot open '" + path + "'");
+
+    fallback_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data_ = fallback_.data();
+    size_ = fallback_.size();
+}
+
+MappedFile::~MappedFile() {}
+
+std::string temporaryPath(const std::string &path) {
+    return path + ".tmp." + std::to_string(_getpid());
+}
+
+void publishFile(const std::string &tmp_path, const std::string &path) {
+    if (!MoveFileExA(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Cannot rename '" + tmp_path + "' to '" + path + "'");
+    }
+}
+
+FileLock::FileLock(const std::string &path) : path_(path) {
+    handle_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle_ == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Cannot open '" + path + "'");
+}
+
+FileLock::~FileLock() {
+    CloseHandle(handle_);
+}
+
+// Windows byte-range locks are mandatory, so the lock is taken on a byte
+// far past the end of any file, where it does not get in the way of writes.
+void FileLock::lock() {
+    OVERLAPPED overlapped{};
+    overlapped.Offset = MAXDWORD;
+    overlapped.OffsetHigh = MAXDWORD;
+    if (!LockFileEx(handle_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped))
+        throw std::runtime_error("Cannot lock '" + path_ + "'");
+}
+
+void FileLock::unlock() {
+    OVERLAPPED overlapped{};
+    overlapped.Offset = MAXDWORD;
+    overlapped.OffsetHigh = MAXDWORD;
+    UnlockFileEx(handle_, 0, 1, 0, &overlapped);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) : data_(nullptr), size_(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open '" + path + "'");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot stat '" + path + "'");
+    }
+
+    size_ = st.st_size;
+    if (size_ > 0) {
+        void *addr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map '" + path + "'");
+        }
+        data_ = static_cast<const std::uint8_t *>(addr);
+    }
+
+    // the mapping stays valid after closing the descriptor
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr)
+        munmap(const_cast<std::uint8_t *>(data_), size_);
+}
+
+std::string temporaryPath(const std::string &path) {
+    return path + ".tmp." + std::to_string(getpid());
+}
+
+void publishFile(const std::string &tmp_path, const std::string &path) {
+    // rename() replaces the file atomically, readers get either version whole
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Cannot rename '" + tmp_path + "' to '" + path + "'");
+    }
+}
+
+FileLock::FileLock(const std::string &path) : path_(path) {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0666);
+    if (fd_ < 0)
+        throw std::runtime_error("Cannot open '" + path + "'");
+}
+
+FileLock::~FileLock() {
+    close(fd_);
+}
+
+void FileLock::lock() {
+    // flock() locks belong to the open file, so other descriptors
+    // of this process on the same file still write freely
+    while (flock(fd_, LOCK_EX) != 0) {
+        if (errno != EINTR)
+            throw std::runtime_error("Cannot lock '" + path_ + "'");
+    }
+}
+
+void FileLock::unlock() {
+    flock(fd_, LOCK_UN);
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file, memory-mapped where the platform allows it,
+// so that processes using the same file share its pages.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile& operator=(const MappedFile &) = delete;
+
+    const std::uint8_t *data() const {return data_;}
+    std::size_t size() const {return size_;}
+
+private:
+    const std::uint8_t *data_;
+    std::size_t size_;
+    std::vector<std::uint8_t> fallback_;
+};
+
+// Tables are written under a name of their own, private to the writing process,
+// and then renamed into place, so that other processes opening `path`
+// at the same time never map a half-written file.
+std::string temporaryPath(const std::string &path);
+// replaces `path` by `tmp_path`; throws std::runtime_error if it can not
+void publishFile(const std::string &tmp_path, const std::string &path);
+
+// Advisory lock on `path` shared with other processes, for files several runs
+// append to. The file is created if it does not exist. Meets BasicLockable,
+// so that it can be held with std::lock_guard.
+class FileLock {
+public:
+    explicit FileLock(const std::string &path);
+    ~FileLock();
+
+    FileLock(const FileLock &) = delete;
+    FileLock& operator=(const FileLock &) = delete;
+
+    // block until no other process holds the lock
+    void lock();
+    void unlock();
+
+private:
+    std::string path_;
+#if defined(_WIN32)
+    void *handle_;
+#else
+    int fd_;
+#endif
+};
+
+#endif
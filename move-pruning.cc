@@ -0,0 +1,38 @@
+#include "move-pruning.h"
+
+#include <algorithm>
+
+namespace {
+
+const std::array<const char *, nb_pruning_rules> rule_names{
+    "cell_to_cell",
+    "lone_to_empty",
+    "empty_targets",
+    "undo",
+};
+
+} // namespace
+
+std::array<bool, nb_pruning_rules> MovePruning::enabled_{};
+std::array<std::atomic<unsigned long long>, nb_pruning_rules> MovePruning::nb_pruned_{};
+
+void MovePruning::enable(PruningRule rule, bool enable) {
+    enabled_[index(rule)] = enable;
+}
+
+bool MovePruning::anyEnabled() {
+    return std::any_of(enabled_.begin(), enabled_.end(), [](bool enabled){return enabled;});
+}
+
+const char *MovePruning::name(PruningRule rule) {
+    return rule_names[index(rule)];
+}
+
+std::optional<PruningRule> MovePruning::fromName(const std::string &name) {
+    for (int i = 0; i < nb_pruning_rules; ++i) {
+        if (name == rule_names[i])
+            return rule(i);
+    }
+
+    return std::nullopt;
+}
@@ -0,0 +1,45 @@
+#ifndef MOVE_PRUNING_H
+#define MOVE_PRUNING_H
+
+#include <array>
+#include <atomic>
+#include <optional>
+#include <string>
+
+// Rules dropping actions whose resulting state is, up to renumbering the
+// free cells or stacks, the current state, the state reached by a sibling
+// action, or the parent state. Such actions never shorten a solution,
+// so no solvable state becomes unsolvable and optimal lengths are kept.
+// ImmediateUndo goes by the action a state was reached by, so solvers
+// which re-parent a known state have to store it reached the new way.
+enum class PruningRule {
+    CellToCell,         // a card from a free cell to another free cell
+    LoneToEmptyStack,   // a whole stack onto an empty stack
+    EquivalentEmpty,    // to an empty free cell or stack other than the first one
+    ImmediateUndo,      // reverting the previous action when no safe move followed it
+};
+
+inline constexpr int nb_pruning_rules = 4;
+
+// Process-wide switches, set before searching, and counters of pruned actions.
+class MovePruning {
+public:
+    static void enable(PruningRule rule, bool enable);
+    static bool enabled(PruningRule rule) {return enabled_[index(rule)];}
+    static bool anyEnabled();
+
+    static void count(PruningRule rule, unsigned long long nb) {nb_pruned_[index(rule)] += nb;}
+    static unsigned long long nbPruned(PruningRule rule) {return nb_pruned_[index(rule)];}
+
+    static const char *name(PruningRule rule);
+    static std::optional<PruningRule> fromName(const std::string &name);
+
+    static int index(PruningRule rule) {return static_cast<int>(rule);}
+    static PruningRule rule(int index) {return static_cast<PruningRule>(index);}
+
+private:
+    static std::array<bool, nb_pruning_rules> enabled_;
+    static std::array<std::atomic<unsigned long long>, nb_pruning_rules> nb_pruned_;
+};
+
+#endif
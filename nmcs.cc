@@ -0,0 +1,85 @@
+#include "search-strategies.h"
+
+#include <cassert>
+
+NestedMonteCarloSearch::NestedMonteCarloSearch(int level, size_t max_depth) :
+        level_(level),
+        max_depth_(max_depth),
+        rng_(1337),
+        best_sequences_(level + 1) {
+    assert(level >= 1);
+    for (auto &sequence : best_sequences_)
+        sequence.reserve(max_depth);
+}
+
+double NestedMonteCarloSearch::nested_(PlayoutBoard &board, int level) {
+	auto &best = best_sequences_[level];
+	auto &lower = best_sequences_[level - 1];
+	best.clear();
+
+	double best_score = playoutScore(board);
+	size_t nb_played = 0;
+	PlayoutBoard::MoveBuffer moves;
+
+	while (!board.isFinal() && board.depth() < board.maxDepth()) {
+		int nb_moves = board.legalMoves(moves);
+		if (nb_moves == 0)
+			break;
+
+		bool any_progress = false;
+		for (int i = 0; i < nb_moves; ++i)
+			any_progress |= board.moveWeight(moves[i]) > 0;
+
+		for (int i = 0; i < nb_moves; ++i) {
+			// same bias as the playouts, shuffling moves are only tried when nothing else is left
+			if (any_progress && board.moveWeight(moves[i]) == 0)
+				continue;
+
+			board.make(moves[i]);
+			lower.clear();
+			double score = level == 1 ? playout(board, rng_, lower) : nested_(board, level - 1);
+			board.unmake();
+
+			if (score > best_score) {
+				best_score = score;
+				// the already played moves are the prefix of the best sequence
+				best.resize(nb_played);
+				best.push_back(moves[i]);
+				best.insert(best.end(), lower.begin(), lower.end());
+			}
+		}
+
+		if (best.size() <= nb_played)
+			break;
+
+		board.make(best[nb_played]);
+		++nb_played;
+	}
+
+	for (size_t i = 0; i < nb_played; ++i)
+		board.unmake();
+
+	return best_score;
+}
+
+std::vector<SearchAction> NestedMonteCarloSearch::solve(const SearchState &init_state) {
+	PlayoutBoard board(init_state.gameState(), max_depth_, SearchState::autoplay(), SearchState::endgameDatabase());
+	if (board.isFinal())
+		return {};
+
+	nested_(board, level_);
+	SearchState::addExpanded(board.nbMade());
+
+	const auto &best = best_sequences_[level_];
+	for (const auto &move : best)
+		board.make(move);
+	if (!board.isFinal())
+		return {};
+
+	std::vector<SearchAction> solution;
+	solution.reserve(best.size());
+	for (const auto &move : best)
+		solution.emplace_back(PlayoutBoard::location(move.from), PlayoutBoard::location(move.to));
+
+	return solution;
+}
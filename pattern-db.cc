@@ -0,0 +1,318 @@
+#include "pattern-db.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+constexpr char pdb_magic[8] = {'F', 'C', 'P', 'D', 'B', '0', '0', '1'};
+constexpr std::uint8_t unknown_distance = 0xff;
+
+// the windows each suit is split into
+const std::vector<std::pair<int, int>> pdb_windows{{1, 6}, {7, king_value}};
+
+constexpr int max_window = 7;
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t nb_windows;
+    std::uint32_t reserved;
+};
+
+struct WindowHeader {
+    std::uint32_t lo;
+    std::uint32_t hi;
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+std::size_t power(std::size_t base, int exponent) {
+    std::size_t result = 1;
+    for (int i = 0; i < exponent; ++i)
+        result *= base;
+    return result;
+}
+
+// Abstract state of a window of k cards: the lowest `nb_home` are home,
+// below[i] is the window card right beneath the i-th card not home
+// (counted from the lowest one), or nb_out if there is none.
+struct PatternState {
+    int nb_home;
+    int nb_out;
+    std::array<int, max_window> below;
+};
+
+// Entries are grouped by the number of cards home, each group
+// holding (nb_out + 1)^nb_out entries.
+class PatternIndexer {
+public:
+    explicit PatternIndexer(int k) : k_(k) {
+        std::size_t offset = 0;
+        for (int nb_home = 0; nb_home <= k; ++nb_home) {
+            offsets_[nb_home] = offset;
+            int nb_out = k - nb_home;
+            offset += power(nb_out + 1, nb_out);
+        }
+        size_ = offset;
+    }
+
+    std::size_t size() const {return size_;}
+
+    std::size_t index(const PatternState &state) const {
+        std::size_t idx = 0;
+        for (int i = state.nb_out - 1; i >= 0; --i)
+            idx = idx * (state.nb_out + 1) + state.below[i];
+        return offsets_[state.nb_home] + idx;
+    }
+
+    PatternState state(std::size_t idx) const {
+        PatternState state;
+        state.nb_home = k_;
+        while (offsets_[state.nb_home] > idx)
+            --state.nb_home;
+        state.nb_out = k_ - state.nb_home;
+
+        idx -= offsets_[state.nb_home];
+        for (int i = 0; i < state.nb_out; ++i) {
+            state.below[i] = idx % (state.nb_out + 1);
+            idx /= state.nb_out + 1;
+        }
+        return state;
+    }
+
+private:
+    int k_;
+    std::size_t size_;
+    std::array<std::size_t, max_window + 1> offsets_;
+};
+
+std::vector<std::uint8_t> computeTable(int k) {
+    PatternIndexer indexer(k);
+    std::vector<std::uint8_t> distances(indexer.size(), unknown_distance);
+
+    PatternState goal;
+    goal.nb_home = k;
+    goal.nb_out = 0;
+
+    std::deque<std::size_t> queue;
+    distances[indexer.index(goal)] = 0;
+    queue.push_back(indexer.index(goal));
+
+    auto relax = [&](const PatternState &pred, int distance, bool free) {
+        auto idx = indexer.index(pred);
+        if (distances[idx] <= distance)
+            return;
+        distances[idx] = distance;
+        if (free)
+            queue.push_front(idx);
+        else
+            queue.push_back(idx);
+    };
+
+    while (!queue.empty()) {
+        auto idx = queue.front();
+        queue.pop_front();
+        int distance = distances[idx];
+        PatternState state = indexer.state(idx);
+
+        std::array<bool, max_window> is_top;
+        std::fill(is_top.begin(), is_top.end(), true);
+        for (int i = 0; i < state.nb_out; ++i) {
+            if (state.below[i] != state.nb_out)
+                is_top[state.below[i]] = false;
+        }
+
+        // the highest home card came from the top of some pile, for free
+        if (state.nb_home > 0) {
+            PatternState pred;
+            pred.nb_home = state.nb_home - 1;
+            pred.nb_out = state.nb_out + 1;
+            for (int i = 0; i < state.nb_out; ++i)
+                pred.below[i + 1] = state.below[i] == state.nb_out ? pred.nb_out : state.below[i] + 1;
+
+            pred.below[0] = pred.nb_out;
+            relax(pred, distance, true);
+            for (int t = 0; t < state.nb_out; ++t) {
+                if (!is_top[t])
+                    continue;
+                pred.below[0] = t + 1;
+                relax(pred, distance, true);
+            }
+        }
+
+        // a top card came from the top of another pile, for one action
+        for (int x = 0; x < state.nb_out; ++x) {
+            if (!is_top[x])
+                continue;
+
+            PatternState pred = state;
+            for (int y = 0; y <= state.nb_out; ++y) {
+                bool y_is_pile = y != state.nb_out;
+                if (y == x || y == state.below[x] || (y_is_pile && !is_top[y]))
+                    continue;
+                pred.below[x] = y;
+                relax(pred, distance + 1, false);
+            }
+        }
+    }
+
+    return distances;
+}
+
+int patternSize(const std::pair<int, int> &window) {
+    return window.second - window.first + 1;
+}
+
+} // namespace
+
+void PatternDatabase::build(const std::string &path) {
+    std::vector<std::vector<std::uint8_t>> tables;
+    for (const auto &window : pdb_windows)
+        tables.push_back(computeTable(patternSize(window)));
+
+    FileHeader header;
+    std::memcpy(header.magic, pdb_magic, sizeof(pdb_magic));
+    header.nb_windows = pdb_windows.size();
+    header.reserved = 0;
+
+    std::vector<WindowHeader> window_headers;
+    std::uint64_t offset = sizeof(FileHeader) + pdb_windows.size() * sizeof(WindowHeader);
+    for (size_t i = 0; i < pdb_windows.size(); ++i) {
+        window_headers.push_back({
+            static_cast<std::uint32_t>(pdb_windows[i].first),
+            static_cast<std::uint32_t>(pdb_windows[i].second),
+            offset,
+            tables[i].size()
+        });
+        offset += tables[i].size();
+    }
+
+    auto tmp_path = temporaryPath(path);
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Cannot write pattern database '" + tmp_path + "'");
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(window_headers.data()), window_headers.size() * sizeof(WindowHeader));
+    for (const auto &table : tables)
+        out.write(reinterpret_cast<const char *>(table.data()), table.size());
+
+    out.close();
+    if (!out) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Failed writing pattern database '" + tmp_path + "'");
+    }
+    publishFile(tmp_path, path);
+}
+
+PatternDatabase::PatternDatabase(const std::string &path) : file_(path) {
+    if (file_.size() < sizeof(FileHeader))
+        throw std::runtime_error("'" + path + "' is not a pattern database");
+
+    FileHeader header;
+    std::memcpy(&header, file_.data(), sizeof(header));
+    if (std::memcmp(header.magic, pdb_magic, sizeof(pdb_magic)) != 0)
+        throw std::runtime_error("'" + path + "' is not a pattern database");
+
+    if (file_.size() < sizeof(FileHeader) + header.nb_windows * sizeof(WindowHeader))
+        throw std::runtime_error("Pattern database '" + path + "' is truncated");
+
+    int covered = 0;
+    for (std::uint32_t i = 0; i < header.nb_windows; ++i) {
+        WindowHeader wh;
+        std::memcpy(&wh, file_.data() + sizeof(FileHeader) + i * sizeof(WindowHeader), sizeof(wh));
+
+        int k = wh.hi - wh.lo + 1;
+        if (k < 1 || k > max_window || wh.size != PatternIndexer(k).size() || wh.offset + wh.size > file_.size())
+            throw std::runtime_error("Pattern database '" + path + "' is corrupted");
+
+        windows_.push_back({static_cast<int>(wh.lo), static_cast<int>(wh.hi), file_.data() + wh.offset});
+        covered += k;
+    }
+
+    if (covered > king_value)
+        throw std::runtime_error("Pattern database '" + path + "' has overlapping windows");
+}
+
+std::shared_ptr<const PatternDatabase> PatternDatabase::open(const std::string &path) {
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const PatternDatabase>> opened;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto db = opened[path].lock();
+    if (db)
+        return db;
+
+    if (!std::ifstream(path))
+        build(path);
+
+    db = std::make_shared<const PatternDatabase>(path);
+    opened[path] = db;
+    return db;
+}
+
+int PatternDatabase::lowerBound(const GameState &state) const {
+    std::array<int, 4> home_values{};
+    bool all_home = true;
+    for (const auto &home : state.homes) {
+        auto opt_top = home.topCard();
+        if (opt_top.has_value())
+            home_values[static_cast<int>(opt_top->color)] = opt_top->value;
+    }
+    for (auto value : home_values)
+        all_home &= value == king_value;
+    if (all_home)
+        return 0;
+
+    // abstract state of every (suit, window), cards are referred to by rank
+    std::array<std::array<PatternState, 4>, 4> patterns; // [window][suit]
+    std::array<std::array<int, king_value + 1>, 4> below_rank{}; // [suit][rank], 0 for none
+
+    for (const auto &stack : state.stacks) {
+        std::array<std::array<int, 4>, 4> last_seen{}; // [window][suit]
+        for (const auto &card : stack.storage()) {
+            int suit = static_cast<int>(card.color);
+            if (card.value <= home_values[suit])
+                continue;
+            for (size_t w = 0; w < windows_.size(); ++w) {
+                if (card.value >= windows_[w].lo && card.value <= windows_[w].hi) {
+                    below_rank[suit][card.value] = last_seen[w][suit];
+                    last_seen[w][suit] = card.value;
+                }
+            }
+        }
+    }
+
+    int total = 0;
+    for (size_t w = 0; w < windows_.size(); ++w) {
+        const auto &window = windows_[w];
+        int k = window.hi - window.lo + 1;
+        PatternIndexer indexer(k);
+
+        for (int suit = 0; suit < 4; ++suit) {
+            PatternState &pattern = patterns[w][suit];
+            pattern.nb_home = std::clamp(home_values[suit] - window.lo + 1, 0, k);
+            pattern.nb_out = k - pattern.nb_home;
+
+            int first_out = window.lo + pattern.nb_home;
+            for (int i = 0; i < pattern.nb_out; ++i) {
+                int below = below_rank[suit][first_out + i];
+                pattern.below[i] = below == 0 ? pattern.nb_out : below - first_out;
+            }
+
+            auto distance = window.table[indexer.index(pattern)];
+            if (distance != unknown_distance)
+                total += distance;
+        }
+    }
+
+    // anything short of the goal takes at least one action
+    return std::max(total, 1);
+}
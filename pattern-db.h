@@ -0,0 +1,47 @@
+#ifndef PATTERN_DB_H
+#define PATTERN_DB_H
+
+#include "game.h"
+#include "mapped-file.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Additive pattern database over windows of consecutive ranks of one suit.
+//
+// A pattern keeps only the cards of its window: how many of them are home
+// and, for every other one, which card of the window lies closest beneath it
+// in the same pile. In this abstraction a card may move onto any pile for one
+// action and goes home for free, as a safe move could take it there.
+// Exact abstract distances are computed by a retrograde 0-1 BFS from the
+// solved pattern. Every action moves one card, so the distances of disjoint
+// patterns add up to an admissible bound on the number of actions.
+//
+// Suits are alike in the abstraction, so one table per window serves all four.
+// Tables are written to a file once and memory-mapped by every user.
+class PatternDatabase {
+public:
+    explicit PatternDatabase(const std::string &path);
+
+    // computes the tables and writes them into `path`
+    static void build(const std::string &path);
+
+    // maps `path`, building it first if it does not exist;
+    // heuristics opened on the same path share one mapping
+    static std::shared_ptr<const PatternDatabase> open(const std::string &path);
+
+    int lowerBound(const GameState &state) const;
+
+private:
+    struct Window {
+        int lo;
+        int hi;
+        const std::uint8_t *table;
+    };
+
+    MappedFile file_;
+    std::vector<Window> windows_;
+};
+
+#endif
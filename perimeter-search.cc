@@ -0,0 +1,199 @@
+#include "search-strategies.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+struct PerimeterNode {
+	SearchState state;
+	size_t parent;
+	// the action from the parent, none for the root
+	SearchAction action;
+	int g;
+};
+
+struct PerimeterOpenEntry {
+	double f;
+	int g;
+	size_t node;
+};
+
+// lowest f first, deeper first among equal f, then older first
+struct PerimeterOpenEntryWorse {
+	bool operator()(const PerimeterOpenEntry &a, const PerimeterOpenEntry &b) const {
+		if (a.f != b.f)
+			return a.f > b.f;
+		if (a.g != b.g)
+			return a.g < b.g;
+		return a.node > b.node;
+	}
+};
+
+GameState solvedState() {
+	GameState solved;
+	for (size_t i = 0; i < colors_list.size(); ++i) {
+		for (int j = 1; j <= king_value; ++j)
+			solved.homes[i].acceptCard({colors_list[i], j});
+	}
+	return solved;
+}
+
+} // namespace
+
+Perimeter::Perimeter(int depth, size_t max_states, int max_taken) :
+	depth_(0),
+	goal_key_(canonicalKey(solvedState()))
+{
+	states_.emplace(goal_key_, Entry{{}, 0, 0});
+	// only the last layer keeps its states, to take their actions back
+	std::vector<GameState> frontier{solvedState()};
+	std::vector<GameState> next_frontier;
+
+	for (int layer = 1; layer <= depth && states_.size() < max_states; ++layer) {
+		next_frontier.clear();
+		for (const auto &state : frontier) {
+			auto key = canonicalKey(state);
+			for (auto &predecessor : settledPredecessors(SearchState(state), max_taken)) {
+				if (states_.size() >= max_states)
+					break;
+				Entry entry{key, predecessor.action.nbCards(), layer};
+				if (!states_.emplace(canonicalKey(predecessor.state), std::move(entry)).second)
+					continue;
+				depth_ = layer;
+				next_frontier.push_back(std::move(predecessor.state));
+			}
+		}
+		frontier.swap(next_frontier);
+	}
+}
+
+std::shared_ptr<const Perimeter> Perimeter::around(int depth, size_t max_states, int max_taken) {
+	static std::mutex mutex;
+	static std::map<std::tuple<int, size_t, int>, std::weak_ptr<const Perimeter>> built;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto &cached = built[{depth, max_states, max_taken}];
+	auto perimeter = cached.lock();
+	if (!perimeter) {
+		perimeter = std::make_shared<const Perimeter>(depth, max_states, max_taken);
+		cached = perimeter;
+	}
+	return perimeter;
+}
+
+std::optional<int> Perimeter::distance(const SearchState &state) const {
+	auto it = states_.find(canonicalKey(state.gameState()));
+	if (it == states_.end())
+		return std::nullopt;
+	return it->second.distance;
+}
+
+std::optional<std::vector<SearchAction>> Perimeter::finish(const SearchState &state) const {
+	std::string key = canonicalKey(state.gameState());
+	if (!states_.count(key))
+		return std::nullopt;
+
+	std::vector<SearchAction> solution;
+	SearchState current = state;
+	while (key != goal_key_) {
+		const auto &entry = states_.at(key);
+		auto action = actionLeadingTo(current, entry.next, entry.nb_cards);
+		if (!action)
+			return std::nullopt;
+		solution.push_back(*action);
+		current = action->execute(current);
+		key = entry.next;
+	}
+	return solution;
+}
+
+std::vector<SearchAction> PerimeterSearch::solve(const SearchState &init_state) {
+	if (!perimeter_)
+		perimeter_ = Perimeter::around(depth_, max_states_, max_taken_);
+
+	if (init_state.isFinal())
+		return {};
+	if (auto tail = perimeter_->finish(init_state))
+		return *tail;
+
+	std::vector<PerimeterNode> nodes;
+	std::unordered_map<std::string, int> best_g;
+	std::priority_queue<PerimeterOpenEntry, std::vector<PerimeterOpenEntry>, PerimeterOpenEntryWorse> open;
+	const double offset = perimeter_->depth();
+
+	auto path_to = [&](size_t node_id) {
+		std::vector<SearchAction> solution;
+		for (size_t i = node_id; i != 0; i = nodes[i].parent)
+			solution.push_back(nodes[i].action);
+		std::reverse(solution.begin(), solution.end());
+		return solution;
+	};
+
+	// reaching the perimeter or a final state gives a solution, but a shorter one
+	// may go through a state still open, so the best is kept until none is left
+	std::vector<SearchAction> best_solution;
+	int best_length = std::numeric_limits<int>::max();
+
+	nodes.push_back({init_state, 0, SearchAction(Location{}, Location{}), 0});
+	best_g.emplace(canonicalKey(init_state.gameState()), 0);
+	open.push({0, 0, 0});
+	ActionList actions;
+
+	while (!open.empty()) {
+		auto entry = open.top();
+		if (entry.f >= best_length)
+			break;
+		open.pop();
+
+		// copied, as the children go into the same vector
+		SearchState current = nodes[entry.node].state;
+		if (best_g.at(canonicalKey(current.gameState())) < entry.g)
+			continue;
+
+		current.actions(actions);
+		for (const auto &action : actions) {
+			SearchState child = action.execute(current);
+			int g = entry.g + 1;
+
+			std::optional<int> left;
+			if (child.isFinal())
+				left = child.distanceLeft();
+			else
+				left = perimeter_->distance(child);
+			if (left.has_value()) {
+				if (g + *left < best_length) {
+					std::optional<std::vector<SearchAction>> tail;
+					if (child.isFinal())
+						tail.emplace();
+					else
+						tail = perimeter_->finish(child);
+					if (!tail)
+						continue;
+					best_length = g + *left;
+					best_solution = path_to(entry.node);
+					best_solution.push_back(action);
+					best_solution.insert(best_solution.end(), tail->begin(), tail->end());
+				}
+				continue;
+			}
+
+			auto key = canonicalKey(child.gameState());
+			auto it = best_g.find(key);
+			if (it != best_g.end() && it->second <= g)
+				continue;
+			best_g[key] = g;
+
+			double h = std::max(compute_heuristic(child, *heuristic_) - offset, 0.0);
+			nodes.push_back({std::move(child), entry.node, action, g});
+			open.push({g + h, g, nodes.size() - 1});
+		}
+	}
+
+	return best_solution;
+}
@@ -0,0 +1,342 @@
+#include "playout.h"
+#include "endgame-db.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+int colorIndex(Color color) {
+    return std::find(colors_list.begin(), colors_list.end(), color) - colors_list.begin();
+}
+
+std::uint8_t cardId(const Card &card) {
+    return colorIndex(card.color) * king_value + card.value - 1;
+}
+
+int cardColor(std::uint8_t card) {
+    return card / king_value;
+}
+
+int cardValue(std::uint8_t card) {
+    return card % king_value + 1;
+}
+
+bool isRed(int color) {
+    static const auto red = [] {
+        std::array<bool, 4> table;
+        for (int i = 0; i < 4; ++i)
+            table[i] = render_color_map.at(colors_list[i]) == RenderColor::Red;
+        return table;
+    }();
+    return red[color];
+}
+
+bool sameRenderColor(std::uint8_t a, std::uint8_t b) {
+    return isRed(cardColor(a)) == isRed(cardColor(b));
+}
+
+bool isCell(int slot) {
+    return slot < nb_freecells;
+}
+
+bool isStack(int slot) {
+    return slot >= nb_freecells && slot < PlayoutBoard::nb_sources;
+}
+
+} // namespace
+
+PlayoutBoard::PlayoutBoard(const GameState &gs, std::size_t max_depth, AutoplayMode autoplay, const EndgameDatabase *endgame_db) :
+        nb_home_(0),
+        autoplay_(autoplay),
+        endgame_db_(endgame_db),
+        max_depth_(max_depth),
+        nb_made_(0) {
+    for (int i = 0; i < nb_freecells; ++i) {
+        auto opt_card = gs.free_cells[i].topCard();
+        cells_[i] = opt_card.has_value() ? cardId(*opt_card) : no_card;
+    }
+
+    for (int i = 0; i < nb_stacks; ++i) {
+        const auto &storage = gs.stacks[i].storage();
+        heights_[i] = storage.size();
+        for (std::size_t j = 0; j < storage.size(); ++j)
+            stacks_[i][j] = cardId(storage[j]);
+    }
+
+    home_values_.fill(0);
+    for (int i = 0; i < nb_homes; ++i) {
+        auto opt_card = gs.homes[i].topCard();
+        home_tops_[i] = opt_card.has_value() ? cardId(*opt_card) : no_card;
+        if (opt_card.has_value()) {
+            home_values_[colorIndex(opt_card->color)] = opt_card->value;
+            nb_home_ += opt_card->value;
+        }
+    }
+
+    // every card can go home at most once, so that is all the safe moves there can be
+    log_.reserve(max_depth + nb_cards);
+    frames_.reserve(max_depth);
+}
+
+GameState PlayoutBoard::gameState() const {
+    auto card = [](std::uint8_t id) {return Card{colors_list[cardColor(id)], cardValue(id)};};
+
+    GameState gs;
+    for (int i = 0; i < nb_freecells; ++i) {
+        if (cells_[i] != no_card)
+            gs.free_cells[i].acceptCard(card(cells_[i]));
+    }
+    for (int i = 0; i < nb_stacks; ++i) {
+        for (int j = 0; j < heights_[i]; ++j)
+            gs.stacks[i].forceCard(card(stacks_[i][j]));
+    }
+    for (int i = 0; i < nb_homes; ++i) {
+        if (home_tops_[i] == no_card)
+            continue;
+        for (int value = 1; value <= cardValue(home_tops_[i]); ++value)
+            gs.homes[i].acceptCard({colors_list[cardColor(home_tops_[i])], value});
+    }
+    return gs;
+}
+
+int PlayoutBoard::distanceLeft_() const {
+    // positions with more cards out are not in the database, no need to look
+    if (!endgame_db_ || nb_cards - nb_home_ > endgame_db_->maxCards())
+        return -1;
+    return endgame_db_->distance(gameState()).value_or(-1);
+}
+
+Location PlayoutBoard::location(std::uint8_t slot) {
+    return locFromSlot(slot);
+}
+
+std::uint8_t PlayoutBoard::topCard_(int slot) const {
+    if (isCell(slot))
+        return cells_[slot];
+    else if (isStack(slot)) {
+        int stack = slot - nb_freecells;
+        return heights_[stack] > 0 ? stacks_[stack][heights_[stack] - 1] : no_card;
+    } else
+        return home_tops_[slot - nb_sources];
+}
+
+int PlayoutBoard::homeFor_(std::uint8_t card) const {
+    // same as findHomeFor(): aces take the first empty home
+    for (int i = 0; i < nb_homes; ++i) {
+        auto top = home_tops_[i];
+        if (top == no_card) {
+            if (cardValue(card) == 1)
+                return i;
+        } else if (top + 1 == card && cardColor(top) == cardColor(card)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool PlayoutBoard::accepts_(int slot, std::uint8_t card) const {
+    if (isCell(slot))
+        return cells_[slot] == no_card;
+
+    if (isStack(slot)) {
+        auto top = topCard_(slot);
+        if (top == no_card)
+            return true;
+        return !sameRenderColor(top, card) && cardValue(card) + 1 == cardValue(top);
+    }
+
+    return homeFor_(card) == slot - nb_sources;
+}
+
+bool PlayoutBoard::couldGoHome_(std::uint8_t card) const {
+    // mirrors cardCouldGoHome()
+    int value = cardValue(card);
+    if (value <= 2)
+        return true;
+
+    // mirrors autoplaySafe()
+    int color = cardColor(card);
+    int opposite_min = king_value;
+    int other_same = king_value;
+    for (int other = 0; other < 4; ++other) {
+        if (isRed(other) != isRed(color))
+            opposite_min = std::min<int>(opposite_min, home_values_[other]);
+        else if (other != color)
+            other_same = home_values_[other];
+    }
+
+    if (opposite_min >= value - 1)
+        return true;
+
+    return autoplay_ == AutoplayMode::Aggressive && opposite_min >= value - 2 && other_same >= value - 3;
+}
+
+bool PlayoutBoard::isWonEndgame_() const {
+    for (int stack = 0; stack < nb_stacks; ++stack) {
+        for (int i = 1; i < heights_[stack]; ++i) {
+            if (cardValue(stacks_[stack][i]) >= cardValue(stacks_[stack][i - 1]))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+int PlayoutBoard::legalMoves(MoveBuffer &moves) const {
+    int nb_moves = 0;
+    for (int from = 0; from < nb_sources; ++from) {
+        auto card = topCard_(from);
+        if (card == no_card)
+            continue;
+
+        for (int to = 0; to < nb_slots; ++to) {
+            if (accepts_(to, card))
+                moves[nb_moves++] = {static_cast<std::uint8_t>(from), static_cast<std::uint8_t>(to)};
+        }
+    }
+
+    return nb_moves;
+}
+
+void PlayoutBoard::moveCard_(int from, int to) {
+    std::uint8_t card;
+    if (isCell(from)) {
+        card = cells_[from];
+        cells_[from] = no_card;
+    } else if (isStack(from)) {
+        int stack = from - nb_freecells;
+        card = stacks_[stack][--heights_[stack]];
+    } else {
+        // only ever used for unmaking a move to home
+        int home = from - nb_sources;
+        card = home_tops_[home];
+        home_tops_[home] = cardValue(card) == 1 ? no_card : card - 1;
+        home_values_[cardColor(card)]--;
+        nb_home_--;
+    }
+
+    if (isCell(to)) {
+        cells_[to] = card;
+    } else if (isStack(to)) {
+        int stack = to - nb_freecells;
+        stacks_[stack][heights_[stack]++] = card;
+    } else {
+        home_tops_[to - nb_sources] = card;
+        home_values_[cardColor(card)]++;
+        nb_home_++;
+    }
+}
+
+void PlayoutBoard::play_(int from, int to) {
+    moveCard_(from, to);
+    log_.push_back({static_cast<std::uint8_t>(from), static_cast<std::uint8_t>(to)});
+}
+
+void PlayoutBoard::runSafeMoves_() {
+    // same order as SearchState::runSafeMoves_(), so that the homes
+    // the aces end up in match the ones of the real game
+    bool endgame = autoplay_ == AutoplayMode::Aggressive && isWonEndgame_();
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        for (int from = 0; from < nb_sources; ++from) {
+            auto card = topCard_(from);
+            if (card == no_card)
+                continue;
+
+            int home = homeFor_(card);
+            if (home >= 0 && (endgame || couldGoHome_(card))) {
+                play_(from, home + nb_sources);
+                moved = true;
+                break;
+            }
+        }
+    }
+}
+
+void PlayoutBoard::make(Move move) {
+    assert(frames_.size() < max_depth_);
+    frames_.push_back(log_.size());
+    nb_made_++;
+    play_(move.from, move.to);
+    runSafeMoves_();
+}
+
+void PlayoutBoard::unmake() {
+    assert(!frames_.empty());
+    std::size_t frame_begin = frames_.back();
+    frames_.pop_back();
+
+    while (log_.size() > frame_begin) {
+        Move last = log_.back();
+        log_.pop_back();
+        moveCard_(last.to, last.from);
+    }
+}
+
+int PlayoutBoard::moveWeight(Move move) const {
+    if (!isCell(move.to) && !isStack(move.to))
+        return 8;
+
+    if (isCell(move.from) && isCell(move.to))
+        return 0;
+
+    if (isStack(move.to) && heights_[move.to - nb_freecells] == 0) {
+        // a lone card to another empty stack changes nothing
+        if (isStack(move.from) && heights_[move.from - nb_freecells] == 1)
+            return 0;
+        return 1;
+    }
+
+    if (isStack(move.to))
+        return isCell(move.from) ? 6 : 4;
+
+    return 1;
+}
+
+double playoutScore(const PlayoutBoard &board) {
+    if (board.isFinal())
+        return 1'000'000.0 - board.depth() - board.distanceLeft();
+
+    return board.nbHome();
+}
+
+double playout(PlayoutBoard &board, std::default_random_engine &rng, std::vector<PlayoutBoard::Move> &sequence) {
+    PlayoutBoard::MoveBuffer moves;
+    std::array<int, PlayoutBoard::max_moves> weights;
+
+    std::size_t start_depth = board.depth();
+
+    while (!board.isFinal() && board.depth() < board.maxDepth()) {
+        int nb_moves = board.legalMoves(moves);
+        if (nb_moves == 0)
+            break;
+
+        int total_weight = 0;
+        for (int i = 0; i < nb_moves; ++i) {
+            weights[i] = board.moveWeight(moves[i]);
+            total_weight += weights[i];
+        }
+
+        int pick = 0;
+        if (total_weight == 0) {
+            pick = std::uniform_int_distribution<int>(0, nb_moves - 1)(rng);
+        } else {
+            int r = std::uniform_int_distribution<int>(0, total_weight - 1)(rng);
+            while (r >= weights[pick])
+                r -= weights[pick++];
+        }
+
+        board.make(moves[pick]);
+        sequence.push_back(moves[pick]);
+    }
+
+    double score = playoutScore(board);
+
+    while (board.depth() > start_depth)
+        board.unmake();
+
+    return score;
+}
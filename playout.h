@@ -0,0 +1,101 @@
+#ifndef PLAYOUT_H
+#define PLAYOUT_H
+
+#include "game.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+class EndgameDatabase;
+
+// Compact copy of a GameState for fast simulations.
+// Cards are stored as one-byte ids, moves are applied in place (make)
+// and reverted from an undo log (unmake), so no allocation happens once
+// the board is constructed.
+// Slots follow the order of GameState::all_storage:
+// free cells, then stacks, then homes.
+class PlayoutBoard {
+public:
+    static constexpr int nb_sources = nb_freecells + nb_stacks;
+    static constexpr int nb_slots = nb_sources + nb_homes;
+    static constexpr int max_moves = nb_sources * nb_slots;
+    static constexpr int nb_cards = 4 * king_value;
+    static constexpr std::uint8_t no_card = 0xff;
+
+    struct Move {
+        std::uint8_t from;
+        std::uint8_t to;
+    };
+    using MoveBuffer = std::array<Move, max_moves>;
+
+    // max_depth bounds the number of moves that can be made without unmaking;
+    // with an endgame database, the positions it can win count as final
+    PlayoutBoard(const GameState &gs, std::size_t max_depth, AutoplayMode autoplay = AutoplayMode::Conservative,
+        const EndgameDatabase *endgame_db = nullptr);
+
+    // fills `moves` in the same order as availableMoves() over a GameState,
+    // returns the number of legal moves
+    int legalMoves(MoveBuffer &moves) const;
+
+    // plays the move followed by the same safe moves SearchState does
+    // under the same autoplay mode
+    void make(Move move);
+    void unmake();
+
+    bool isFinal() const {return nb_home_ == nb_cards || distanceLeft_() >= 0;}
+    // actions still needed to win from a final board, as SearchState::distanceLeft()
+    int distanceLeft() const {return std::max(distanceLeft_(), 0);}
+    GameState gameState() const;
+    int nbHome() const {return nb_home_;}
+    std::size_t depth() const {return frames_.size();}
+    std::size_t maxDepth() const {return max_depth_;}
+    unsigned long long nbMade() const {return nb_made_;}
+
+    // how promising the move is for a playout, 0 for moves that
+    // merely shuffle cards around without making any progress
+    int moveWeight(Move move) const;
+
+    static Location location(std::uint8_t slot);
+
+private:
+    static constexpr int max_height = nb_cards;
+
+    std::uint8_t topCard_(int slot) const;
+    bool accepts_(int slot, std::uint8_t card) const;
+    int homeFor_(std::uint8_t card) const;
+    bool couldGoHome_(std::uint8_t card) const;
+    bool isWonEndgame_() const;
+    // the endgame database's distance, -1 without one or outside of it
+    int distanceLeft_() const;
+    void moveCard_(int from, int to);
+    void play_(int from, int to);
+    void runSafeMoves_();
+
+    std::array<std::array<std::uint8_t, max_height>, nb_stacks> stacks_;
+    std::array<std::uint8_t, nb_stacks> heights_;
+    std::array<std::uint8_t, nb_freecells> cells_;
+    std::array<std::uint8_t, nb_homes> home_tops_;
+    std::array<std::int8_t, 4> home_values_; // by color
+    int nb_home_;
+
+    AutoplayMode autoplay_;
+    const EndgameDatabase *endgame_db_;
+    std::size_t max_depth_;
+    unsigned long long nb_made_;
+    std::vector<Move> log_;
+    std::vector<std::uint32_t> frames_;
+};
+
+// Plays weighted random moves until the game is won, stuck or
+// the board depth limit is reached. Made moves are appended to `sequence`
+// and undone before returning, the result is the playout score.
+double playout(PlayoutBoard &board, std::default_random_engine &rng, std::vector<PlayoutBoard::Move> &sequence);
+
+// Win beats everything, shorter wins (counted from where the board
+// was constructed, up to the actual win) beat longer ones, otherwise the more cards home the better.
+double playoutScore(const PlayoutBoard &board);
+
+#endif
@@ -1,81 +1,273 @@
 #include "search-interface.h"
 #include "game.h"
+#include "endgame-db.h"
 
 #include <cassert>
 #include <algorithm>
+#include <unordered_set>
 
 
 unsigned long long SearchState::nbExpanded() {
     return SearchState::nb_expanded;
 }
 
+void SearchState::addExpanded(unsigned long long nb) {
+    SearchState::nb_expanded += nb;
+}
+
+void SearchState::enableSupermoves(bool enable) {
+    SearchState::supermoves = enable;
+}
+
+bool SearchState::supermovesEnabled() {
+    return SearchState::supermoves;
+}
+
+void SearchState::setAutoplay(AutoplayMode mode) {
+    SearchState::autoplay_mode = mode;
+}
+
+AutoplayMode SearchState::autoplay() {
+    return SearchState::autoplay_mode;
+}
+
+void SearchState::setEndgameDatabase(std::shared_ptr<const EndgameDatabase> db) {
+    SearchState::endgame_db = std::move(db);
+}
+
+const EndgameDatabase *SearchState::endgameDatabase() {
+    return SearchState::endgame_db.get();
+}
+
 bool operator<(const SearchState &a, const SearchState &b) {
     return a.state_ < b.state_;
 }
 
+bool operator==(const SearchState &a, const SearchState &b) {
+    return a.state_ == b.state_;
+}
+
 SearchState SearchAction::execute(const SearchState& state) const {
 	SearchState new_state(state);
-	bool succeeded = new_state.execute(from_, to_);
+	bool succeeded = new_state.execute(from_, to_, nb_cards_, nullptr);
+	assert(succeeded);
+
+	return new_state;
+}
+
+SearchState SearchAction::execute(const SearchState& state, MoveTrail &trail) const {
+	SearchState new_state(state);
+	trail.clear();
+	bool succeeded = new_state.execute(from_, to_, nb_cards_, &trail);
 	assert(succeeded);
 
 	return new_state;
 }
 
+std::vector<SearchAction> SearchAction::expand(const SearchState &state) const {
+	if (nb_cards_ == 1)
+		return {*this};
+
+	std::vector<SearchAction> steps;
+	SearchState in_progress(state);
+	for (const auto &step : planSupermove(state.gameState(), from_, to_, nb_cards_)) {
+		if (cardIsHome(in_progress.gameState(), {step.color, step.value}))
+			continue;
+
+		bool succeeded = in_progress.execute(step.from, step.to);
+		assert(succeeded);
+		steps.emplace_back(step.from, step.to);
+	}
+
+	return steps;
+}
+
 bool SearchState::execute(Location from, Location to) {
+	return execute(from, to, 1, nullptr);
+}
+
+bool SearchState::execute(Location from, Location to, MoveTrail *trail) {
+	return execute(from, to, 1, trail);
+}
+
+bool SearchState::execute(Location from, Location to, size_t nb_cards, MoveTrail *trail) {
 	auto from_ptr = ptrFromLoc(state_, from);
 	auto to_ptr = ptrFromLoc(state_, to);
 
-	if (!moveLegal(from_ptr, to_ptr))
-		return false;
+	if (nb_cards == 1) {
+		if (!moveLegal(from_ptr, to_ptr))
+			return false;
+
+		if (trail)
+			trail->push(from, to, *from_ptr->topCard());
+		move(const_cast<CardStorage *>(from_ptr), const_cast<CardStorage *>(to_ptr));
+	} else {
+		if (from.cl != LocationClass::Stacks || to.cl != LocationClass::Stacks)
+			return false;
+
+		auto from_stack = &state_.stacks[from.id];
+		auto to_stack = &state_.stacks[to.id];
+		if (!supermoveLegal(state_, from_stack, to_stack, nb_cards))
+			return false;
 
-	move(const_cast<CardStorage *>(from_ptr), const_cast<CardStorage *>(to_ptr));
+		if (trail) {
+			// top card first, so that undoing the trail backwards restores the run in order
+			const auto &cards = from_stack->storage();
+			for (size_t i = 0; i < nb_cards; ++i)
+				trail->push(from, to, cards[cards.size() - 1 - i]);
+		}
+		supermove(from_stack, to_stack, nb_cards);
+	}
 
-	runSafeMoves_();
+	bool went_home = runSafeMoves_(trail);
+	last_from_ = from;
+	last_to_ = to;
+	last_nb_cards_ = went_home ? 0 : nb_cards;
 
     SearchState::nb_expanded++;
 
 	return true;
 }
 
-void SearchState::runSafeMoves_() {
-	std::vector<RawMove> safe_moves;
-	while ((safe_moves = safeHomeMoves(state_)), safe_moves.size() > 0) {
-		const CardStorage *from = safe_moves[0].first;
-		const CardStorage *to = safe_moves[0].second;
+bool SearchState::runSafeMoves_(MoveTrail *trail) {
+	// in a won endgame the safety checks are skipped, once won it stays so
+	bool endgame = autoplay_mode == AutoplayMode::Aggressive && isWonEndgame(state_);
 
-		move(const_cast<CardStorage *>(from), const_cast<CardStorage *>(to));
+	bool went_home = false;
+	bool moved = true;
+	while (moved) {
+		moved = false;
+
+		// the first card in non_homes order goes, then the sources are scanned again
+		for (auto source : state_.non_homes) {
+			auto opt_card = source->topCard();
+			if (!opt_card.has_value() || state_.homeValue(opt_card->color) != opt_card->value - 1)
+				continue;
+			if (!endgame && !autoplaySafe(opt_card->color, opt_card->value, state_.index.home_value, autoplay_mode))
+				continue;
+
+			auto home = findHomeFor(state_, *opt_card);
+			if (trail)
+				trail->push(locFromPtr(state_, source), locFromPtr(state_, &*home), *opt_card);
+			const_cast<HomeDestination &>(*home).acceptCard(*source->getCard());
+			moved = went_home = true;
+			break;
+		}
 	}
+
+	return went_home;
+}
+
+SearchState SearchState::settled(GameState state) {
+	SearchState settled_state(std::move(state));
+	settled_state.runSafeMoves_(nullptr);
+	return settled_state;
 }
 
 bool SearchState::isFinal() const {
+	if (isWon())
+		return true;
+
+	return endgame_db && endgame_db->distance(state_).has_value();
+}
+
+int SearchState::distanceLeft() const {
+	if (isWon() || !endgame_db)
+		return 0;
+
+	return endgame_db->distance(state_).value_or(0);
+}
+
+bool SearchState::isWon() const {
 	for (auto color : colors_list) {
-		if (!cardIsHome(state_, {color, king_value}))
+		if (state_.homeValue(color) != king_value)
 			return false;
 	}
 
 	return true;
 }
 
-unsigned long long SearchState::nb_expanded = 0;
+thread_local unsigned long long SearchState::nb_expanded = 0;
+bool SearchState::supermoves = false;
+AutoplayMode SearchState::autoplay_mode = AutoplayMode::Conservative;
+std::shared_ptr<const EndgameDatabase> SearchState::endgame_db;
 
 std::vector<SearchAction> SearchState::actions() const {
-	auto raw_moves = availableMoves(
-		state_.non_homes.begin(),
-		state_.non_homes.end(),
-		state_.all_storage.begin(),
-		state_.all_storage.end()
-	);	
-
-	std::vector<SearchAction> moves;
-	std::transform(
-		raw_moves.begin(),
-		raw_moves.end(),
-		std::back_inserter(moves),
-		[&](RawMove raw_move){
-			return SearchAction{locFromPtr(state_, raw_move.first), locFromPtr(state_, raw_move.second)};
+	ActionList buffer;
+	actions(buffer);
+	return {buffer.begin(), buffer.end()};
+}
+
+void SearchState::actions(ActionList &actions) const {
+	actions.clear();
+	bool pruning = MovePruning::anyEnabled();
+	std::array<unsigned long long, nb_pruning_rules> nb_pruned{};
+	auto add = [&](const SearchAction &action) {
+		if (!pruning || !pruned_(action, nb_pruned))
+			actions.push_back(action);
+	};
+
+	SlotMoveBuffer slot_moves;
+	int nb_slot_moves = legalMoves(state_, slot_moves);
+	for (int i = 0; i < nb_slot_moves; ++i)
+		add({locFromSlot(slot_moves[i].from), locFromSlot(slot_moves[i].to)});
+
+	if (supermoves) {
+		for (long from = 0; from < nb_stacks; ++from) {
+			size_t run_length = orderedRunLength(state_.stacks[from]);
+			for (long to = 0; to < nb_stacks; ++to) {
+				for (size_t nb_cards = 2; nb_cards <= run_length; ++nb_cards) {
+					if (supermoveLegal(state_, &state_.stacks[from], &state_.stacks[to], nb_cards))
+						add({Location{LocationClass::Stacks, from}, Location{LocationClass::Stacks, to}, nb_cards});
+				}
+			}
 		}
-	);
-	return moves;
+	}
+
+	for (int i = 0; i < nb_pruning_rules; ++i) {
+		if (nb_pruned[i] > 0)
+			MovePruning::count(MovePruning::rule(i), nb_pruned[i]);
+	}
+}
+
+bool SearchState::pruned_(const SearchAction &action, std::array<unsigned long long, nb_pruning_rules> &nb_pruned) const {
+	auto prune = [&](PruningRule rule) {
+		if (!MovePruning::enabled(rule))
+			return false;
+		nb_pruned[MovePruning::index(rule)]++;
+		return true;
+	};
+
+	Location from = action.from();
+	Location to = action.to();
+
+	if (from.cl == LocationClass::FreeCells && to.cl == LocationClass::FreeCells && prune(PruningRule::CellToCell))
+		return true;
+
+	bool to_empty_stack = to.cl == LocationClass::Stacks && state_.stacks[to.id].nbCards() == 0;
+	if (from.cl == LocationClass::Stacks && to_empty_stack && state_.stacks[from.id].nbCards() == action.nbCards()
+			&& prune(PruningRule::LoneToEmptyStack))
+		return true;
+
+	if (to.cl == LocationClass::FreeCells || to_empty_stack) {
+		// empty targets of a kind are interchangeable, only the first one is kept
+		bool first_empty = true;
+		if (to.cl == LocationClass::FreeCells) {
+			for (long i = 0; i < to.id; ++i)
+				first_empty = first_empty && state_.free_cells[i].topCard().has_value();
+		} else {
+			for (long i = 0; i < to.id; ++i)
+				first_empty = first_empty && state_.stacks[i].nbCards() > 0;
+		}
+		if (!first_empty && prune(PruningRule::EquivalentEmpty))
+			return true;
+	}
+
+	if (last_nb_cards_ == action.nbCards() && from == last_to_ && to == last_from_
+			&& prune(PruningRule::ImmediateUndo))
+		return true;
+
+	return false;
 }
 
 std::ostream& operator<< (std::ostream& os, const SearchState & state) {
@@ -85,5 +277,196 @@ std::ostream& operator<< (std::ostream& os, const SearchState & state) {
 
 std::ostream& operator<< (std::ostream& os, const SearchAction & action) {
 	os << action.from_ << " " << action.to_;
+	if (action.nb_cards_ > 1)
+		os << " (" << action.nb_cards_ << " cards)";
 	return os;
 }
+
+std::optional<std::vector<SearchAction>> replaySolution(const SearchState &state, const std::vector<SlotMove> &moves) {
+    return replaySolution(state, state.gameState(), moves);
+}
+
+std::optional<std::vector<SearchAction>> replaySolution(const SearchState &state, const GameState &moves_from, const std::vector<SlotMove> &moves) {
+    // `raw` plays the moves as they are, to tell which card each one moves
+    GameState raw(moves_from);
+    SearchState played(state);
+    std::vector<SearchAction> actions;
+
+    for (const auto &move : moves) {
+        auto raw_from = raw.all_storage[move.from];
+        auto card = raw_from->topCard();
+        if (!card.has_value() || !moveLegal(raw_from, raw.all_storage[move.to]))
+            return std::nullopt;
+        ::move(raw_from, raw.all_storage[move.to]);
+
+        const auto &gs = played.gameState();
+        if (cardIsHome(gs, *card))
+            continue;
+
+        // the homes aces take may differ once some went home on their own
+        auto slot = gs.slotOf(*card);
+        Location from = locFromSlot(slot);
+        Location to = locFromSlot(move.to);
+        if (to.cl == LocationClass::Homes) {
+            auto home = findHomeFor(gs, *card);
+            if (home == gs.homes.end())
+                return std::nullopt;
+            to = {LocationClass::Homes, home - gs.homes.begin()};
+        } else if (to.cl == LocationClass::FreeCells && gs.free_cells[to.id].topCard().has_value()) {
+            auto free_cell = std::find_if(gs.free_cells.begin(), gs.free_cells.end(),
+                [](const FreeCell &cell){return !cell.topCard().has_value();});
+            if (free_cell == gs.free_cells.end())
+                return std::nullopt;
+            to = {LocationClass::FreeCells, free_cell - gs.free_cells.begin()};
+        }
+
+        if (gs.all_storage[slot]->topCard() != card || !played.execute(from, to))
+            return std::nullopt;
+        actions.emplace_back(from, to);
+    }
+
+    if (!played.isWon())
+        return std::nullopt;
+
+    return actions;
+}
+
+std::vector<SearchAction> completeSolution(const SearchState &init_state, std::vector<SearchAction> solution) {
+    const auto *db = SearchState::endgameDatabase();
+    if (!db)
+        return solution;
+
+    SearchState played(init_state);
+    for (const auto &action : solution)
+        played = action.execute(played);
+
+    // a fresh state, so that no action is held back for undoing the last one
+    SearchState state(played.gameState());
+    ActionList actions;
+    auto distance = db->distance(state.gameState());
+    while (distance.value_or(0) > 0) {
+        int wanted = *distance - 1;
+        state.actions(actions);
+        auto next = std::find_if(actions.begin(), actions.end(), [&](const SearchAction &action) {
+            return db->distance(action.execute(state).gameState()) == wanted;
+        });
+        if (next == actions.end())
+            break;
+        solution.push_back(*next);
+        state = SearchState(next->execute(state).gameState());
+        distance = wanted;
+    }
+
+    return solution;
+}
+
+namespace {
+
+struct PredecessorSearch {
+	std::string target;
+	std::unordered_set<std::string> visited;
+	std::unordered_set<std::string> found;
+	std::vector<SettledPredecessor> predecessors;
+
+	// whether runSafeMoves_() would leave `gs` as it is, without copying it
+	static bool isSettled(const GameState &gs) {
+		auto mode = SearchState::autoplay();
+		bool endgame = mode == AutoplayMode::Aggressive && isWonEndgame(gs);
+		for (auto source : gs.non_homes) {
+			auto card = source->topCard();
+			if (card.has_value() && gs.homeValue(card->color) == card->value - 1
+					&& (endgame || autoplaySafe(card->color, card->value, gs.index.home_value, mode)))
+				return false;
+		}
+		return true;
+	}
+
+	// keeps `before` if it is settled and `action` takes it to the target
+	void tryAction(const GameState &before, const SearchAction &action) {
+		if (!isSettled(before))
+			return;
+		auto key = canonicalKey(before);
+		if (found.count(key))
+			return;
+
+		SearchState after(before);
+		if (!after.execute(action.from(), action.to(), action.nbCards(), nullptr) || canonicalKey(after.gameState()) != target)
+			return;
+		found.insert(std::move(key));
+		predecessors.push_back({before, action});
+	}
+
+	// the top nb_cards of `from` onto `to` in the same order, wherever they land
+	static void shiftRun(WorkStack &from, WorkStack &to, size_t nb_cards) {
+		std::vector<Card> run;
+		for (size_t i = 0; i < nb_cards; ++i)
+			run.push_back(*from.getCard());
+		for (auto it = run.rbegin(); it != run.rend(); ++it)
+			to.forceCard(*it);
+	}
+
+	// takes moves back in place, putting them forward again afterwards
+	void takeBack(GameState &gs, int taken_left) {
+		constexpr int first_stack = nb_freecells;
+		constexpr int first_home = nb_freecells + nb_stacks;
+
+		SlotMoveBuffer moves;
+		int nb_moves = reverseMoves(gs, moves);
+		for (int i = 0; i < nb_moves; ++i) {
+			auto card = *gs.all_storage[moves[i].to]->topCard();
+			unplayMove(&gs, moves[i]);
+			tryAction(gs, SearchAction(locFromSlot(moves[i].from), locFromSlot(moves[i].to)));
+
+			// or the card went home on its own, which it only did if it was safe to
+			if (taken_left > 0 && moves[i].to >= first_home) {
+				bool safe = autoplaySafe(card.color, card.value, gs.index.home_value, SearchState::autoplay())
+					|| (SearchState::autoplay() == AutoplayMode::Aggressive && isWonEndgame(gs));
+				if (safe && visited.insert(canonicalKey(gs)).second)
+					takeBack(gs, taken_left - 1);
+			}
+
+			::move(gs.all_storage[moves[i].from], gs.all_storage[moves[i].to]);
+		}
+
+		if (!SearchState::supermovesEnabled())
+			return;
+		// runs moved onto another stack at once
+		for (int to = 0; to < nb_stacks; ++to) {
+			size_t run_length = orderedRunLength(gs.stacks[to]);
+			for (size_t nb_cards = 2; nb_cards <= run_length; ++nb_cards) {
+				for (int from = 0; from < nb_stacks; ++from) {
+					if (from == to)
+						continue;
+					shiftRun(gs.stacks[to], gs.stacks[from], nb_cards);
+					tryAction(gs, SearchAction(locFromSlot(first_stack + from), locFromSlot(first_stack + to), nb_cards));
+					shiftRun(gs.stacks[from], gs.stacks[to], nb_cards);
+				}
+			}
+		}
+	}
+};
+
+} // namespace
+
+std::vector<SettledPredecessor> settledPredecessors(const SearchState &state, int max_taken) {
+	PredecessorSearch search;
+	search.target = canonicalKey(state.gameState());
+	search.visited.insert(search.target);
+	GameState gs(state.gameState());
+	search.takeBack(gs, max_taken);
+	return std::move(search.predecessors);
+}
+
+std::optional<SearchAction> actionLeadingTo(const SearchState &state, const std::string &key, size_t nb_cards) {
+	constexpr int first_home = nb_freecells + nb_stacks;
+	for (int from = 0; from < first_home; ++from) {
+		for (int to = 0; to < CardIndex::nb_slots; ++to) {
+			if (from == to || (nb_cards > 1 && (locFromSlot(from).cl != LocationClass::Stacks || locFromSlot(to).cl != LocationClass::Stacks)))
+				continue;
+			SearchState next(state);
+			if (next.execute(locFromSlot(from), locFromSlot(to), nb_cards, nullptr) && canonicalKey(next.gameState()) == key)
+				return SearchAction(locFromSlot(from), locFromSlot(to), nb_cards);
+		}
+	}
+	return std::nullopt;
+}
@@ -3,49 +3,208 @@
 
 #include "move.h"
 #include "game.h"
+#include "move-pruning.h"
 
+#include <array>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
 #include <ostream>
+#include <type_traits>
 
 class SearchState;
 
 class AStarHeuristicItf;
 
+class EndgameDatabase;
+
 class SearchAction {
 public:
-	SearchAction(Location from, Location to) : from_(from), to_(to) {} ;
+	SearchAction(Location from, Location to, size_t nb_cards = 1) : from_(from), to_(to), nb_cards_(nb_cards) {} ;
 	SearchState execute(const SearchState& state) const ;
+	// same, recording every moved card into `trail`
+	SearchState execute(const SearchState& state, MoveTrail &trail) const ;
+
+	Location from() const {return from_;}
+	Location to() const {return to_;}
+	size_t nbCards() const {return nb_cards_;}
+	// single-card actions playing this one from `state`, a supermove gets
+	// split into its steps, leaving out cards which went home on their own meanwhile
+	std::vector<SearchAction> expand(const SearchState &state) const ;
 
     friend std::ostream& operator<< (std::ostream& os, const SearchAction & action) ;
 private:
 	Location from_;
 	Location to_;
+	size_t nb_cards_;
+};
+
+// Fixed-capacity list of actions, so that successors can be enumerated
+// without touching the heap. Holds every action a position can have:
+// all single-card moves plus every supermove length between two stacks.
+class ActionList {
+public:
+    static constexpr size_t capacity = max_slot_moves + nb_stacks * (nb_stacks - 1) * king_value;
+
+    ActionList() : size_(0) {}
+    ActionList(const ActionList &) = delete;
+    ActionList& operator=(const ActionList &) = delete;
+
+    void clear() {size_ = 0;}
+    void push_back(const SearchAction &action) {
+        assert(size_ < capacity);
+        new (&storage_[size_++]) SearchAction(action);
+    }
+
+    size_t size() const {return size_;}
+    bool empty() const {return size_ == 0;}
+    const SearchAction *begin() const {return data_();}
+    const SearchAction *end() const {return data_() + size_;}
+    const SearchAction &operator[](size_t i) const {return data_()[i];}
+
+private:
+    using Slot = std::aligned_storage_t<sizeof(SearchAction), alignof(SearchAction)>;
+    static_assert(std::is_trivially_destructible_v<SearchAction>);
+
+    const SearchAction *data_() const {return std::launder(reinterpret_cast<const SearchAction *>(storage_.data()));}
+
+    std::array<Slot, capacity> storage_;
+    size_t size_;
 };
 
 class SearchState {
 public:
     explicit SearchState(GameState state) : state_(state) {}
+    // `state` as execute() would leave it, with the safe moves played
+    static SearchState settled(GameState state);
 
+	// won, or with an endgame database set, in it and winnable
 	bool isFinal() const;
+	// all cards home
+	bool isWon() const;
+	// actions still needed to win from a final state: none once won,
+	// the endgame database's distance otherwise
+	int distanceLeft() const;
 	std::vector<SearchAction> actions() const;
+	// same, into a caller-provided buffer which is cleared first
+	void actions(ActionList &actions) const;
 
 	bool execute(Location from, Location to);
+	bool execute(Location from, Location to, MoveTrail *trail);
+	bool execute(Location from, Location to, size_t nb_cards, MoveTrail *trail);
+    const GameState &gameState() const {return state_;}
+
+    // states expanded by the calling thread, so that games solved
+    // side by side are measured apart
     static unsigned long long nbExpanded();
+    // for strategies that expand states without going through execute(),
+    // or on threads of their own
+    static void addExpanded(unsigned long long nb);
+
+    // whether actions() offers supermoves besides single-card moves,
+    // to be set before searching
+    static void enableSupermoves(bool enable);
+    static bool supermovesEnabled();
+    // which cards execute() plays home on its own, to be set before searching
+    static void setAutoplay(AutoplayMode mode);
+    static AutoplayMode autoplay();
+    // Set before searching: states the database can win count as final,
+    // so every search stops there; completeSolution() then plays the rest.
+    // Solvers comparing solution lengths add distanceLeft() to them.
+    static void setEndgameDatabase(std::shared_ptr<const EndgameDatabase> db);
+    static const EndgameDatabase *endgameDatabase();
 
     friend std::ostream& operator<< (std::ostream& os, const SearchState & state) ;
     friend bool operator<(const SearchState &a, const SearchState &b) ;
     friend bool operator==(const SearchState &a, const SearchState &b) ;
     friend double compute_heuristic(const SearchState &state, const AStarHeuristicItf &heuristic);
 private:
-	void runSafeMoves_();
+	// returns whether any card went home
+	bool runSafeMoves_(MoveTrail *trail);
+	bool pruned_(const SearchAction &action, std::array<unsigned long long, nb_pruning_rules> &nb_pruned) const;
+
 	GameState state_;
-    static unsigned long long nb_expanded;
+	// the action which led here, if it may be undone by a single action;
+	// not part of the state's identity
+	Location last_from_{};
+	Location last_to_{};
+	size_t last_nb_cards_ = 0;
+    static thread_local unsigned long long nb_expanded;
+    static bool supermoves;
+    static AutoplayMode autoplay_mode;
+    static std::shared_ptr<const EndgameDatabase> endgame_db;
+};
+
+
+// The single-card moves of a known solution (see isSolution()) as actions from `state`,
+// leaving out the cards which went home on their own; nullopt if the safe moves
+// get in the way of the remaining ones.
+std::optional<std::vector<SearchAction>> replaySolution(const SearchState &state, const std::vector<SlotMove> &moves);
+// same, for moves made from `moves_from`, which may differ from `state` by cards
+// already home and as canonicalKey() does; the free cells the moves fill are taken as they come
+std::optional<std::vector<SearchAction>> replaySolution(const SearchState &state, const GameState &moves_from, const std::vector<SlotMove> &moves);
+
+// `solution` from `init_state` followed by the actions the endgame database
+// gives to win from where it leads; as it is if there is nothing to add
+std::vector<SearchAction> completeSolution(const SearchState &init_state, std::vector<SearchAction> solution);
+
+// A state with its safe moves played, one action before another one.
+struct SettledPredecessor {
+    GameState state;
+    // leads from `state` to the successor, safe moves included
+    SearchAction action;
+};
+
+// Settled states from which an action, followed by the safe moves it lets go,
+// leads to the settled `state` up to canonicalKey(). The action is taken back
+// after taking out of the homes up to max_taken cards the safe moves could have
+// played there, so a predecessor may hold several cards more than `state`.
+// Complete for predecessors which have at most max_taken cards go home on their
+// own; each comes once up to canonicalKey().
+std::vector<SettledPredecessor> settledPredecessors(const SearchState &state, int max_taken);
+
+// the action of nb_cards cards from `state` leading to a state with canonicalKey() `key`,
+// nullopt if there is none; the way back along settledPredecessors() up to canonicalKey()
+std::optional<SearchAction> actionLeadingTo(const SearchState &state, const std::string &key, size_t nb_cards);
+
+// heuristic value of `state` reached through `trail` from a state valued `parent_bound`
+double compute_heuristic_after(double parent_bound, const SearchState &state, const MoveTrail &trail, const AStarHeuristicItf &heuristic);
+
+// heuristic value of `state`, or any value >= cutoff if it is not lower
+double compute_heuristic_cutoff(const SearchState &state, double cutoff, const AStarHeuristicItf &heuristic);
+
+// batch counterpart of compute_heuristic
+void compute_heuristics(const SearchState *const *states, size_t nb_states, const AStarHeuristicItf &heuristic, double *bounds);
+
+namespace std {
+template <> struct hash<SearchState> {
+    size_t operator()(const SearchState &state) const {
+        return hash<GameState>()(state.gameState());
+    }
 };
+}
 
 
 class SearchStrategyItf {
 public:
+	using SolutionCallback = std::function<void(const std::vector<SearchAction> &)>;
+
 	virtual std::vector<SearchAction> solve(const SearchState &init_state) =0 ;
 	virtual ~SearchStrategyItf() {}
+
+	// anytime strategies report every improved solution through this as soon as it is found
+	void onSolution(SolutionCallback callback) {solution_callback_ = std::move(callback);}
+
+protected:
+	void publishSolution(const std::vector<SearchAction> &solution) const {
+		if (solution_callback_)
+			solution_callback_(solution);
+	}
+
+private:
+	SolutionCallback solution_callback_;
 };
 
 #endif
@@ -3,19 +3,51 @@
 
 #include "search-interface.h"
 #include "game.h"
+#include "playout.h"
+#include "thread-pool.h"
+#include "pattern-db.h"
 
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+// Random restarts run in parallel, attempt i draws its moves from
+// a stream seeded by (base seed, i). The successful attempt with the lowest
+// index wins and cancels all the later ones, so the result does not
+// depend on the number of threads.
 class DummySearch : public SearchStrategyItf {
 public:
-	DummySearch(size_t max_depth, size_t nb_attempts);
+	DummySearch(size_t max_depth, size_t nb_attempts, size_t nb_threads = 1, unsigned base_seed = 1337);
 	std::vector<SearchAction> solve(const SearchState &init_state) override ;
 
 private:
+	std::vector<SearchAction> attempt_(const SearchState &init_state, size_t attempt, const std::atomic<size_t> &best_attempt) const;
+
 	size_t max_depth_;
 	size_t nb_attempts_;
+	unsigned base_seed_;
+	ThreadPool pool_;
+};
+
+// Nested Monte Carlo Search over a PlayoutBoard.
+// Level 1 picks each move by a weighted random playout after every
+// candidate, higher levels use the level below instead of playouts.
+// Each level follows the best sequence it has found so far.
+class NestedMonteCarloSearch : public SearchStrategyItf {
+public:
+	NestedMonteCarloSearch(int level, size_t max_depth);
+	std::vector<SearchAction> solve(const SearchState &init_state) override ;
+
+private:
+	double nested_(PlayoutBoard &board, int level);
+
+	int level_;
+	size_t max_depth_;
 	std::default_random_engine rng_;
+	std::vector<std::vector<PlayoutBoard::Move>> best_sequences_;
 };
 
 
@@ -42,6 +74,26 @@ private:
 class AStarHeuristicItf {
 public:
     virtual double distanceLowerBound(const GameState &state) const =0;
+
+    // Scores states[0] ... states[nb_states-1] into bounds[0] ... bounds[nb_states-1].
+    // Solvers pass all successors of a node at once; implementations
+    // can override this to work across the whole batch.
+    virtual void distanceLowerBounds(const GameState *const *states, size_t nb_states, double *bounds) const;
+
+    // Value of `state`, reached through the moves in `trail` from a state
+    // valued `parent_bound`. Heuristics which can update their value from the
+    // moved cards alone override this together with isIncremental(),
+    // solvers then skip the full evaluation. The default recomputes it.
+    virtual double distanceLowerBoundAfter(double parent_bound, const GameState &state, const MoveTrail &trail) const;
+    virtual bool isIncremental() const {return false;}
+
+    // Like distanceLowerBound(), but the evaluation may stop as soon as
+    // the bound is known to reach `cutoff`, returning any value >= cutoff.
+    virtual double distanceLowerBoundCutoff(const GameState &state, double cutoff) const;
+    // rough relative price of one evaluation, cheaper heuristics go first in MaxHeuristic
+    virtual int evaluationCost() const {return 1;}
+
+    virtual ~AStarHeuristicItf() {}
 };
 
 
@@ -58,10 +110,206 @@ private:
     size_t mem_limit_;
 };
 
+// Breadth-first search keeping only the beam_width states with the lowest
+// heuristic value in each layer. States already kept in any layer are
+// not kept again, so memory is bounded by beam_width * max_depth states.
+class BeamSearch : public SearchStrategyItf {
+public:
+    BeamSearch(std::unique_ptr<AStarHeuristicItf> &&heuristic, size_t beam_width, size_t max_depth) :
+        heuristic_(std::move(heuristic)),
+        beam_width_(beam_width),
+        max_depth_(max_depth)
+        {}
+	std::vector<SearchAction> solve(const SearchState &init_state) override ;
+
+private:
+    const std::unique_ptr<AStarHeuristicItf> heuristic_;
+    size_t beam_width_;
+    size_t max_depth_;
+};
+
+// Anytime weighted A*: expands by g + weight * h, starting with a large
+// weight to find some solution fast. After each solution the weight is lowered
+// by weight_step (down to 1) and the search continues with the same open and
+// closed lists, pruning nodes which cannot beat the best solution so far.
+// Every improvement is published; the best one is returned when the open
+// list runs out or time_limit passes (zero means no limit).
+class AnytimeAStarSearch : public SearchStrategyItf {
+public:
+    AnytimeAStarSearch(std::unique_ptr<AStarHeuristicItf> &&heuristic, double initial_weight, double weight_step, std::chrono::milliseconds time_limit) :
+        heuristic_(std::move(heuristic)),
+        initial_weight_(initial_weight),
+        weight_step_(weight_step),
+        time_limit_(time_limit)
+        {}
+	std::vector<SearchAction> solve(const SearchState &init_state) override ;
+
+private:
+    const std::unique_ptr<AStarHeuristicItf> heuristic_;
+    double initial_weight_;
+    double weight_step_;
+    std::chrono::milliseconds time_limit_;
+};
+
+// Depth-first branch and bound: depth-first search trying the children with
+// the lowest heuristic value first, cutting every node whose g + h reaches the
+// length of the best solution so far. Every improvement is published.
+// The best solution can be seeded before solving, from outside through
+// setUpperBound() or by an initial run of another strategy.
+// Memory is linear in the depth, states on the current path are never revisited;
+// with tt_size > 0 a transposition table of up to that many states also cuts
+// states already reached by a path at least as short.
+class DepthFirstBranchAndBound : public SearchStrategyItf {
+public:
+    DepthFirstBranchAndBound(
+        std::unique_ptr<AStarHeuristicItf> &&heuristic,
+        size_t max_depth,
+        size_t tt_size,
+        std::chrono::milliseconds time_limit,
+        std::unique_ptr<SearchStrategyItf> &&initial = nullptr
+    ) :
+        heuristic_(std::move(heuristic)),
+        initial_(std::move(initial)),
+        max_depth_(max_depth),
+        tt_size_(tt_size),
+        time_limit_(time_limit)
+        {}
+	std::vector<SearchAction> solve(const SearchState &init_state) override ;
+
+    // for the next solve() only: look for solutions shorter than `length`;
+    // `solution`, if given, has that length and is returned if none is shorter
+    void setUpperBound(size_t length, std::vector<SearchAction> solution = {});
+
+private:
+    const std::unique_ptr<AStarHeuristicItf> heuristic_;
+    const std::unique_ptr<SearchStrategyItf> initial_;
+    size_t max_depth_;
+    size_t tt_size_;
+    std::chrono::milliseconds time_limit_;
+
+    std::optional<size_t> upper_bound_;
+    std::vector<SearchAction> incumbent_;
+};
+
+// Bidirectional breadth-first search: a forward search from the deal and
+// a backward one from the solved state, each expanding a layer in turn,
+// the smaller frontier first. Both sides step between states with their safe
+// moves played, the backward one through settledPredecessors() taking back up
+// to max_taken cards per action out of the homes, and keep one state per
+// canonicalKey(). Once a forward state is in the backward table, the backward
+// half is replayed from there. Shortest when no predecessor on the way needs
+// more than max_taken cards taken out. Gives up once the two searches hold
+// max_states states together.
+class BidirectionalSearch : public SearchStrategyItf {
+public:
+    BidirectionalSearch(size_t max_states, int max_taken) : max_states_(max_states), max_taken_(max_taken) {}
+	std::vector<SearchAction> solve(const SearchState &init_state) override ;
+
+private:
+    size_t max_states_;
+    int max_taken_;
+};
+
+// The states within `depth` actions of the solved state, found by a backward
+// breadth-first search over settledPredecessors() taking back up to max_taken
+// cards per action, keyed by canonicalKey(). The same for every deal, so one
+// is built per depth, budget and max_taken and shared.
+class Perimeter {
+public:
+    // stops early once max_states states have been reached
+    Perimeter(int depth, size_t max_states, int max_taken);
+
+    static std::shared_ptr<const Perimeter> around(int depth, size_t max_states, int max_taken);
+
+    // the most actions any state kept takes to win, lower than asked if the budget ran out
+    int depth() const {return depth_;}
+    size_t size() const {return states_.size();}
+
+    // the actions `state` takes to win through the perimeter, nullopt if it is not in it
+    std::optional<int> distance(const SearchState &state) const;
+    // those actions
+    std::optional<std::vector<SearchAction>> finish(const SearchState &state) const;
+
+private:
+    struct Entry {
+        // canonicalKey() of the state one action closer to the solved one,
+        // reached by an action of nb_cards cards
+        std::string next;
+        size_t nb_cards;
+        int distance;
+    };
+
+    int depth_;
+    std::string goal_key_;
+    std::unordered_map<std::string, Entry> states_;
+};
+
+// A* from the deal towards the states of a Perimeter, finished through it.
+// A perimeter state takes at most depth() actions to win, so max(h - depth(), 0)
+// bounds the way to the perimeter when h bounds the way to the goal.
+// Reaching the perimeter gives a solution, the best one is returned once no open
+// state can lead to a shorter one; the shortest with an admissible heuristic,
+// as long as the perimeter holds every state within its depth.
+class PerimeterSearch : public SearchStrategyItf {
+public:
+    PerimeterSearch(std::unique_ptr<AStarHeuristicItf> &&heuristic, int depth, size_t max_states, int max_taken) :
+        heuristic_(std::move(heuristic)),
+        depth_(depth),
+        max_states_(max_states),
+        max_taken_(max_taken)
+        {}
+	std::vector<SearchAction> solve(const SearchState &init_state) override ;
+
+private:
+    const std::unique_ptr<AStarHeuristicItf> heuristic_;
+    int depth_;
+    size_t max_states_;
+    int max_taken_;
+    std::shared_ptr<const Perimeter> perimeter_;
+};
+
 // beware, this has been proven to NOT be a valid heuristic!
 class OufOfHome_Pseudo : public AStarHeuristicItf {
 public:
     double distanceLowerBound(const GameState &state) const override;
+    void distanceLowerBounds(const GameState *const *states, size_t nb_states, double *bounds) const override;
+    double distanceLowerBoundAfter(double parent_bound, const GameState &state, const MoveTrail &trail) const override;
+    bool isIncremental() const override {return true;}
+};
+
+// admissible, see PatternDatabase
+class PatternDbHeuristic : public AStarHeuristicItf {
+public:
+    explicit PatternDbHeuristic(const std::string &path) : db_(PatternDatabase::open(path)) {}
+    double distanceLowerBound(const GameState &state) const override;
+    int evaluationCost() const override {return 3;}
+
+private:
+    std::shared_ptr<const PatternDatabase> db_;
+};
+
+// admissible: a card lying above a lower card of its own suit can not go
+// home before that card does, so it takes at least one explicit move
+class BlockedCardsHeuristic : public AStarHeuristicItf {
+public:
+    double distanceLowerBound(const GameState &state) const override;
+    double distanceLowerBoundAfter(double parent_bound, const GameState &state, const MoveTrail &trail) const override;
+    bool isIncremental() const override {return true;}
+    int evaluationCost() const override {return 2;}
+};
+
+// Maximum of several heuristics, admissible if all of them are.
+// Components are evaluated from the cheapest one and the rest is skipped
+// once the maximum reaches the cutoff.
+class MaxHeuristic : public AStarHeuristicItf {
+public:
+    explicit MaxHeuristic(std::vector<std::unique_ptr<AStarHeuristicItf>> &&components);
+    double distanceLowerBound(const GameState &state) const override;
+    double distanceLowerBoundCutoff(const GameState &state, double cutoff) const override;
+    int evaluationCost() const override;
+
+private:
+    std::vector<std::unique_ptr<AStarHeuristicItf>> components_;
 };
 
 class StudentHeuristic : public AStarHeuristicItf {
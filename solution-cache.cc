@@ -0,0 +1,175 @@
+#include "solution-cache.h"
+#include "deal-corpus.h"
+#include "mapped-file.h"
+
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+constexpr char cache_magic[8] = {'F', 'C', 'S', 'O', 'L', 'C', '0', '1'};
+
+struct RecordHeader {
+    std::uint64_t config_hash;
+    std::uint8_t deal[deal_size];
+    std::uint32_t nb_actions;
+    std::uint8_t solved;
+    std::uint8_t reserved[7];
+    std::uint64_t nb_expanded;
+    std::uint64_t time_us;
+    std::uint64_t first_solution_us;
+};
+static_assert(sizeof(RecordHeader) == 96);
+
+// from slot, to slot, number of cards
+constexpr std::size_t action_size = 3;
+
+// FNV-1a
+std::uint64_t configHash(const std::string &config) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : config) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// what store() writes, so that a damaged record is not mistaken for one
+// an interrupted run cut short
+bool plausibleHeader(const RecordHeader &header) {
+    if (header.solved > 1)
+        return false;
+    for (auto byte : header.reserved)
+        if (byte != 0)
+            return false;
+    return true;
+}
+
+bool plausibleActions(const std::uint8_t *action, std::size_t nb_actions) {
+    constexpr std::size_t nb_slots = nb_freecells + nb_stacks + nb_homes;
+    for (std::size_t i = 0; i < nb_actions; ++i, action += action_size)
+        if (action[0] >= nb_slots || action[1] >= nb_slots || action[2] == 0 || action[2] > king_value)
+            return false;
+    return true;
+}
+
+std::string dealKey(const GameState &deal) {
+    auto encoded = encodeDeal(deal);
+    return std::string(encoded.begin(), encoded.end());
+}
+
+} // namespace
+
+SolutionCache::SolutionCache(const std::string &path, const std::string &config) :
+    path_(path),
+    config_hash_(configHash(config)),
+    file_lock_(path)
+{
+    // other runs may be appending to the same file
+    std::lock_guard<FileLock> file_lock(file_lock_);
+
+    std::vector<char> bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    if (!bytes.empty() && (bytes.size() < sizeof(cache_magic) || std::memcmp(bytes.data(), cache_magic, sizeof(cache_magic)) != 0))
+        throw std::runtime_error("'" + path + "' is not a solution cache");
+
+    auto corrupt = [&](std::size_t pos) {
+        return std::runtime_error("Solution cache '" + path + "' is damaged at offset " + std::to_string(pos));
+    };
+
+    std::size_t pos = sizeof(cache_magic);
+    while (pos + sizeof(RecordHeader) <= bytes.size()) {
+        RecordHeader header;
+        std::memcpy(&header, bytes.data() + pos, sizeof(header));
+        if (!plausibleHeader(header))
+            throw corrupt(pos);
+
+        const auto *actions = reinterpret_cast<const std::uint8_t *>(bytes.data() + pos + sizeof(header));
+        std::size_t record_size = sizeof(header) + std::size_t(header.nb_actions) * action_size;
+        if (pos + record_size > bytes.size()) {
+            // only the last record can have been cut short, and then what
+            // made it to the file still reads as actions
+            std::size_t nb_present = (bytes.size() - pos - sizeof(header)) / action_size;
+            if (!plausibleActions(actions, nb_present))
+                throw corrupt(pos);
+            break;
+        }
+        if (!plausibleActions(actions, header.nb_actions))
+            throw corrupt(pos);
+
+        if (header.config_hash == config_hash_) {
+            Entry entry{header.solved != 0, {}, header.nb_expanded,
+                std::chrono::microseconds(header.time_us), std::chrono::microseconds(header.first_solution_us)};
+            const auto *action = actions;
+            for (std::uint32_t i = 0; i < header.nb_actions; ++i, action += action_size)
+                entry.solution.emplace_back(locFromSlot(action[0]), locFromSlot(action[1]), action[2]);
+            entries_.insert_or_assign(std::string(std::begin(header.deal), std::end(header.deal)), std::move(entry));
+        }
+        pos += record_size;
+    }
+
+    if (bytes.empty() || pos != bytes.size()) {
+        // a new file, or one whose last record was cut short: rewrite what is whole
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (bytes.empty())
+            out.write(cache_magic, sizeof(cache_magic));
+        else
+            out.write(bytes.data(), pos);
+        if (!out)
+            throw std::runtime_error("Cannot write solution cache '" + path + "'");
+    }
+
+    out_.open(path, std::ios::binary | std::ios::app);
+    if (!out_)
+        throw std::runtime_error("Cannot write solution cache '" + path + "'");
+}
+
+std::optional<SolutionCache::Entry> SolutionCache::find(const GameState &deal) const {
+    auto key = dealKey(deal);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+void SolutionCache::store(const GameState &deal, const Entry &entry) {
+    auto key = dealKey(deal);
+
+    RecordHeader header{};
+    header.config_hash = config_hash_;
+    std::memcpy(header.deal, key.data(), deal_size);
+    header.nb_actions = entry.solution.size();
+    header.solved = entry.solved;
+    header.nb_expanded = entry.nb_expanded;
+    header.time_us = entry.time_taken.count();
+    header.first_solution_us = entry.first_solution_time.count();
+
+    std::vector<std::uint8_t> actions;
+    actions.reserve(entry.solution.size() * action_size);
+    for (const auto &action : entry.solution) {
+        actions.push_back(slotFromLoc(action.from()));
+        actions.push_back(slotFromLoc(action.to()));
+        actions.push_back(action.nbCards());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.insert_or_assign(key, entry);
+    std::lock_guard<FileLock> file_lock(file_lock_);
+    // flushed record by record, so that an interrupted run keeps what it solved
+    out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out_.write(reinterpret_cast<const char *>(actions.data()), actions.size());
+    out_.flush();
+    if (!out_)
+        throw std::runtime_error("Failed writing solution cache '" + path_ + "'");
+}
+
+std::size_t SolutionCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
@@ -0,0 +1,58 @@
+#ifndef SOLUTION_CACHE_H
+#define SOLUTION_CACHE_H
+
+#include "game.h"
+#include "mapped-file.h"
+#include "search-interface.h"
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Outcomes of earlier runs, kept on disk across runs and keyed by the deal
+// (see encodeDeal()) and a string naming the solver configuration.
+//
+// The file is a header followed by one record per stored outcome, appended
+// as games are solved: the hash of the configuration, the deal, the statistics
+// and the actions of the solution. Records of other configurations are left
+// alone and a later record for the same deal replaces an earlier one.
+// A last record cut short by an interrupted run is dropped when the file is
+// opened, any other damage makes opening it throw. Runs sharing the file take
+// an advisory lock on it while they read, rewrite or append to it.
+// Entries are taken as they are, callers check them by replaying the solution.
+class SolutionCache {
+public:
+    struct Entry {
+        // false for a game the solver gave up on, the solution is then empty
+        bool solved;
+        std::vector<SearchAction> solution;
+        unsigned long long nb_expanded;
+        std::chrono::microseconds time_taken;
+        std::chrono::microseconds first_solution_time;
+    };
+
+    // reads the entries of `config` from `path`, creating the file if it does not exist;
+    // throws if it is not a solution cache or is damaged
+    SolutionCache(const std::string &path, const std::string &config);
+
+    std::optional<Entry> find(const GameState &deal) const;
+    // keeps the entry and appends it to the file
+    void store(const GameState &deal, const Entry &entry);
+
+    std::size_t size() const;
+
+private:
+    std::string path_;
+    std::uint64_t config_hash_;
+    std::ofstream out_;
+    FileLock file_lock_;
+    mutable std::mutex mutex_;
+    // by the encoded deal
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+#endif
@@ -1,47 +1,123 @@
 #include "search-strategies.h"
 
+#include <cassert>
 #include <chrono>
 #include <thread>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 double compute_heuristic(const SearchState &state, const AStarHeuristicItf &heuristic) {
     return heuristic.distanceLowerBound(state.state_);
 }
 
-DummySearch::DummySearch(size_t max_depth, size_t nb_attempts) :
+double compute_heuristic_after(double parent_bound, const SearchState &state, const MoveTrail &trail, const AStarHeuristicItf &heuristic) {
+    return heuristic.distanceLowerBoundAfter(parent_bound, state.gameState(), trail);
+}
+
+double compute_heuristic_cutoff(const SearchState &state, double cutoff, const AStarHeuristicItf &heuristic) {
+    return heuristic.distanceLowerBoundCutoff(state.gameState(), cutoff);
+}
+
+void compute_heuristics(const SearchState *const *states, size_t nb_states, const AStarHeuristicItf &heuristic, double *bounds) {
+    constexpr size_t chunk = 64;
+    const GameState *game_states[chunk];
+
+    for (size_t begin = 0; begin < nb_states; begin += chunk) {
+        size_t size = std::min(chunk, nb_states - begin);
+        for (size_t i = 0; i < size; ++i)
+            game_states[i] = &states[begin + i]->gameState();
+        heuristic.distanceLowerBounds(game_states, size, bounds + begin);
+    }
+}
+
+void AStarHeuristicItf::distanceLowerBounds(const GameState *const *states, size_t nb_states, double *bounds) const {
+    for (size_t i = 0; i < nb_states; ++i)
+        bounds[i] = distanceLowerBound(*states[i]);
+}
+
+double AStarHeuristicItf::distanceLowerBoundCutoff(const GameState &state, double) const {
+    return distanceLowerBound(state);
+}
+
+double AStarHeuristicItf::distanceLowerBoundAfter(double, const GameState &state, const MoveTrail &) const {
+    return distanceLowerBound(state);
+}
+
+DummySearch::DummySearch(size_t max_depth, size_t nb_attempts, size_t nb_threads, unsigned base_seed) :
         max_depth_(max_depth),
         nb_attempts_(nb_attempts),
-        rng_(1337) {
+        base_seed_(base_seed),
+        pool_(nb_threads) {
 	; // just for initializer list	
 }
 
-std::vector<SearchAction> DummySearch::solve(const SearchState &init_state) {
-	for (size_t i = 0; i < nb_attempts_; ++i) {
-		std::vector<SearchAction> solution;
-		SearchState working_state(init_state);
+std::vector<SearchAction> DummySearch::attempt_(const SearchState &init_state, size_t attempt, const std::atomic<size_t> &best_attempt) const {
+	std::seed_seq seed{base_seed_, static_cast<unsigned>(attempt)};
+	std::default_random_engine rng(seed);
 
-		for (size_t depth = 0; depth < max_depth_ ; ++depth) {
-			auto actions = working_state.actions();
+	std::vector<SearchAction> solution;
+	solution.reserve(max_depth_);
+	SearchState working_state(init_state);
+	ActionList actions;
 
-			// on a dead end
-			if (actions.size() == 0)
-				break; // start over
+	for (size_t depth = 0; depth < max_depth_ ; ++depth) {
+		// an earlier attempt has already succeeded
+		if (best_attempt < attempt)
+			return {};
 
-			auto action = actions[0];
-			// actually, pick a random action
-			std::sample(actions.begin(), actions.end(), &action, 1, rng_);
+		working_state.actions(actions);
 
-			solution.push_back(action);
-			working_state = action.execute(working_state);
+		// on a dead end
+		if (actions.size() == 0)
+			break; // start over
 
-			if (working_state.isFinal())
-				return solution;
-		}
+		auto action = actions[0];
+		// actually, pick a random action
+		std::sample(actions.begin(), actions.end(), &action, 1, rng);
+
+		solution.push_back(action);
+		// played in place, the state is not copied
+		bool succeeded = working_state.execute(action.from(), action.to(), action.nbCards(), nullptr);
+		assert(succeeded);
+
+		if (working_state.isFinal())
+			return solution;
 	}
 
 	return {};
 }
 
+std::vector<SearchAction> DummySearch::solve(const SearchState &init_state) {
+	std::atomic<size_t> best_attempt{nb_attempts_};
+	std::vector<SearchAction> best_solution;
+	std::mutex best_mutex;
+	// expansions are counted per thread, those of the workers go to the caller's count
+	const auto caller = std::this_thread::get_id();
+	std::atomic<unsigned long long> nb_expanded_elsewhere{0};
+
+	pool_.parallelFor(nb_attempts_, [&](size_t attempt) {
+		if (best_attempt < attempt)
+			return;
+
+		auto expanded_before = SearchState::nbExpanded();
+		auto solution = attempt_(init_state, attempt, best_attempt);
+		if (std::this_thread::get_id() != caller)
+			nb_expanded_elsewhere += SearchState::nbExpanded() - expanded_before;
+		if (solution.empty())
+			return;
+
+		std::lock_guard<std::mutex> lock(best_mutex);
+		if (attempt < best_attempt) {
+			best_attempt = attempt;
+			best_solution = std::move(solution);
+		}
+	});
+	SearchState::addExpanded(nb_expanded_elsewhere);
+
+	return best_solution;
+}
+
 double OufOfHome_Pseudo::distanceLowerBound(const GameState &state) const {
     int cards_out_of_home = king_value * colors_list.size();
     for (const auto &home : state.homes) {
@@ -53,3 +129,31 @@ double OufOfHome_Pseudo::distanceLowerBound(const GameState &state) const {
     return cards_out_of_home;
 }
 
+double OufOfHome_Pseudo::distanceLowerBoundAfter(double parent_bound, const GameState &, const MoveTrail &trail) const {
+    return parent_bound - trail.nbToHomes();
+}
+
+void OufOfHome_Pseudo::distanceLowerBounds(const GameState *const *states, size_t nb_states, double *bounds) const {
+    // gather the home tops first, so that the summation runs over plain arrays
+    constexpr size_t chunk = 64;
+    int home_values[nb_homes][chunk];
+
+    for (size_t begin = 0; begin < nb_states; begin += chunk) {
+        size_t size = std::min(chunk, nb_states - begin);
+        for (size_t i = 0; i < size; ++i) {
+            for (int h = 0; h < nb_homes; ++h) {
+                auto opt_top = states[begin + i]->homes[h].topCard();
+                home_values[h][i] = opt_top.has_value() ? opt_top->value : 0;
+            }
+        }
+
+        const int all_cards = king_value * colors_list.size();
+        for (size_t i = 0; i < size; ++i)
+            bounds[begin + i] = all_cards - home_values[0][i] - home_values[1][i] - home_values[2][i] - home_values[3][i];
+    }
+}
+
+
+double PatternDbHeuristic::distanceLowerBound(const GameState &state) const {
+    return db_->lowerBound(state);
+}
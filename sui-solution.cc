@@ -8,39 +8,59 @@
 
 
 std::vector<SearchAction> BreadthFirstSearch::solve(const SearchState &init_state) {
-	std::queue<std::shared_ptr<SearchState>> q;
+	std::queue<std::pair<std::shared_ptr<SearchState>, int>> q;
 	std::map<SearchState, std::shared_ptr<SearchState>> parent;
 	std::map<SearchState, SearchAction> actions;
 
 	std::shared_ptr<SearchState> shared_init_state = std::make_shared<SearchState>(init_state);
-	q.push(shared_init_state);
+	q.push({shared_init_state, 0});
 	parent[init_state] = std::make_shared<SearchState>(init_state); 
+	ActionList current_actions;
+
+	// Reconstruct the path of actions that led to the final state
+	auto path_to = [&](std::shared_ptr<SearchState> state) {
+		std::vector<SearchAction> solution;
+		while (state != shared_init_state) {
+			solution.push_back(actions.at(*state));
+			state = parent[*state];
+		}
+		std::reverse(solution.begin(), solution.end());
+		return solution;
+	};
+
+	// with an endgame database, final states may still be some actions away
+	// from the win, so the best one is kept until no shorter solution is left
+	std::shared_ptr<SearchState> best_final;
+	int best_length = std::numeric_limits<int>::max();
 	
 	while (!q.empty()) {
-		std::shared_ptr<SearchState> current_state = q.front();
+		auto [current_state, depth] = q.front();
 		q.pop();
+		if (depth + 1 >= best_length)
+			return path_to(best_final);
 
-		for (auto action : current_state->actions()) {
+		current_state->actions(current_actions);
+		for (const auto &action : current_actions) {
 			std::shared_ptr<SearchState> new_state = std::make_shared<SearchState>(action.execute(*current_state));
 			// If the key is not present, find returns an iterator to end
 			if (parent.find(*new_state) == parent.end()) {
-				q.push(new_state);
+				q.push({new_state, depth + 1});
 				parent[*new_state] = current_state;
 				actions.insert(std::pair<SearchState, SearchAction>(*new_state, action));
 			}
 			
 			if (new_state->isFinal()) {
-				std::vector<SearchAction> solution;
-				// Reconstruct the path of actions that led to the final state
-				while (new_state != shared_init_state) {
-					solution.push_back(actions.at(*new_state));
-					new_state = parent[*new_state];
+				int length = depth + 1 + new_state->distanceLeft();
+				if (length < best_length) {
+					best_length = length;
+					best_final = new_state;
 				}
-				return solution;
+				if (best_length <= depth + 1)
+					return path_to(best_final);
 			}
 		}
 	}
-	return {};
+	return best_final ? path_to(best_final) : std::vector<SearchAction>{};
 }
 
 std::vector<SearchAction> DepthFirstSearch::solve(const SearchState &init_state) {
@@ -57,6 +77,7 @@ std::vector<SearchAction> DepthFirstSearch::solve(const SearchState &init_state)
 	info[init_state].action = nullptr;
 	info[init_state].parent = shared_init_state;
 	info[init_state].depth = 0;
+	ActionList current_actions;
 
 	while (!s.empty()) {
 		std::shared_ptr<SearchState> current_state = s.top();
@@ -66,7 +87,8 @@ std::vector<SearchAction> DepthFirstSearch::solve(const SearchState &init_state)
 		if (curr_depth <= depth_limit_) {
 			int new_depth = curr_depth + 1;
 
-			for (auto action : current_state->actions()) {
+			current_state->actions(current_actions);
+			for (const auto &action : current_actions) {
 				std::shared_ptr<SearchState> new_state = std::make_shared<SearchState>(action.execute(*current_state));
 				
 				// Do not push states that were already seen
@@ -109,15 +131,24 @@ std::vector<SearchAction> AStarSearch::solve(const SearchState &init_state) {
 		std::shared_ptr<SearchAction> action;
 		std::shared_ptr<SearchState> parent;
 		int depth;
+		int h;
+		// actions left from a final state the endgame database knows, -1 for other states
+		int left;
 	};
 	std::map<std::shared_ptr<SearchState>, struct node_info> info;
 	std::set<SearchState> closed;
+	std::vector<std::shared_ptr<SearchState>> successors;
+	std::vector<const SearchState *> successor_ptrs;
+	std::vector<double> successor_bounds;
 	std::shared_ptr<SearchState> shared_init_state = std::make_shared<SearchState>(init_state);
 
 	open.insert(shared_init_state);
 	info[shared_init_state].parent = std::make_shared<SearchState>(init_state);
 	info[shared_init_state].action = nullptr;
 	info[shared_init_state].depth = 0;
+	info[shared_init_state].h = compute_heuristic(init_state, *heuristic_);
+	info[shared_init_state].left = -1;
+	ActionList best_actions;
 	
 	while (!open.empty()) {
 		int best = std::numeric_limits<int>::max();
@@ -125,8 +156,9 @@ std::vector<SearchAction> AStarSearch::solve(const SearchState &init_state) {
 
 		// Looking for best candidate for expanding based on heuristic
 		for (std::shared_ptr<SearchState> state_ptr: open) {
-			int h = compute_heuristic(*state_ptr, *heuristic_);
-			int g = info[state_ptr].depth;
+			const auto &n_info = info[state_ptr];
+			int h = n_info.h;
+			int g = n_info.depth;
 			// std::cout << "BEST: " << best << "\nh(x)+g(x): " << h + g << std::endl << std::endl;
 			if (h + g < best) {
 				best = h + g;
@@ -134,11 +166,21 @@ std::vector<SearchAction> AStarSearch::solve(const SearchState &init_state) {
 			}
 		}
 
+		if (info[best_choice].left >= 0) {
+			std::vector<SearchAction> solution;
+			for (auto state = best_choice; state != shared_init_state; state = info[state].parent)
+				solution.push_back(*(info.at(state).action));
+			std::reverse(solution.begin(), solution.end());
+			return solution;
+		}
+
 		open.erase(best_choice);
 		closed.insert(*best_choice);
 		int new_depth = info[best_choice].depth + 1;
+		successors.clear();
 
-		for (auto action : best_choice->actions()) {
+		best_choice->actions(best_actions);
+		for (const auto &action : best_actions) {
 			std::shared_ptr<SearchState> new_state = std::make_shared<SearchState>(action.execute(*best_choice));
 			// If the key is not present, find returns an iterator to end
 			if (closed.find(*new_state) == closed.end()) {
@@ -146,12 +188,20 @@ std::vector<SearchAction> AStarSearch::solve(const SearchState &init_state) {
 				struct node_info n_info = {
 					std::make_shared<SearchAction>(action),
 					best_choice,
-					new_depth
+					new_depth,
+					0,
+					-1
 				};
 				info.insert(std::pair<std::shared_ptr<SearchState>, node_info>(new_state, n_info));
+				successors.push_back(new_state);
 			}
 			
-			if (new_state->isFinal()) {
+			// a final state still away from the win is only taken once it is the best
+			// choice, valued by its exact distance, as shorter solutions may go elsewhere
+			if (new_state->isFinal() && new_state->distanceLeft() > 0) {
+				if (info.count(new_state) > 0)
+					info[new_state].left = new_state->distanceLeft();
+			} else if (new_state->isFinal()) {
 				std::vector<SearchAction> solution;
 				// Reconstruct the path of actions that led to the final state
 				while (new_state != shared_init_state) {
@@ -163,6 +213,17 @@ std::vector<SearchAction> AStarSearch::solve(const SearchState &init_state) {
 				return solution;
 			}
 		}
+
+		// score all the new successors at once, each state is scored just once
+		successor_ptrs.clear();
+		for (const auto &successor : successors)
+			successor_ptrs.push_back(successor.get());
+		successor_bounds.resize(successors.size());
+		compute_heuristics(successor_ptrs.data(), successor_ptrs.size(), *heuristic_, successor_bounds.data());
+		for (size_t i = 0; i < successors.size(); ++i) {
+			auto &n_info = info[successors[i]];
+			n_info.h = n_info.left >= 0 ? n_info.left : successor_bounds[i];
+		}
 	}
 	return {};
 }
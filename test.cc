@@ -4,7 +4,21 @@
 #include "card-storage.h"
 #include "move.h"
 #include "game.h"
-
+#include "evaluation-type.h"
+#include "deal-corpus.h"
+#include "deal-text.h"
+#include "deal-pipeline.h"
+#include "pattern-db.h"
+#include "endgame-db.h"
+#include "solution-cache.h"
+#include "search-strategies.h"
+#include "playout.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
 #include <sstream>
 
 std::string cardRepresentation(const Card &card) {
@@ -459,3 +473,1162 @@ TEST_CASE("Ptr -> location conversion") {
     REQUIRE(locFromPtr(gs, &gs.free_cells[3]) == Location{LocationClass::FreeCells, 3});
 }
 
+
+TEST_CASE("Log histogram percentiles") {
+    LogHistogram hist;
+    REQUIRE(hist.count() == 0);
+    REQUIRE(hist.percentile(50) == 0);
+
+    for (std::uint64_t v = 1; v <= 100; ++v)
+        hist.record(v);
+
+    REQUIRE(hist.count() == 100);
+    REQUIRE(hist.max() == 100);
+    REQUIRE(hist.mean() == Approx(50.5));
+
+    // exact below 32, within the bucket precision above
+    REQUIRE(hist.percentile(10) == 10);
+    REQUIRE(hist.percentile(50) >= 50);
+    REQUIRE(hist.percentile(50) <= 53);
+    REQUIRE(hist.percentile(99) >= 99);
+    REQUIRE(hist.percentile(100) == 100);
+
+    hist.record(1'000'000);
+    REQUIRE(hist.percentile(100) == 1'000'000);
+    REQUIRE(hist.percentile(99) <= 103);
+}
+
+TEST_CASE("Log histogram merging") {
+    LogHistogram a, b;
+    for (std::uint64_t v = 0; v < 10; ++v)
+        a.record(v);
+    for (std::uint64_t v = 1000; v < 1010; ++v)
+        b.record(v);
+
+    a.merge(b);
+    REQUIRE(a.count() == 20);
+    REQUIRE(a.max() == 1009);
+    REQUIRE(a.percentile(50) == 9);
+    REQUIRE(a.percentile(55) >= 1000);
+
+    StrategyEvaluation x, y;
+    x.nb_solved = 2;
+    y.nb_solved = 3;
+    y.nb_failed = 1;
+    y.time_distribution.record(42);
+    x += y;
+    REQUIRE(x.nb_solved == 5);
+    REQUIRE(x.nb_failed == 1);
+    REQUIRE(x.time_distribution.count() == 1);
+}
+
+TEST_CASE("Pattern database bounds") {
+    const std::string path = "test-bin.pdb";
+    PatternDatabase::build(path);
+    // written aside and renamed into place
+    CHECK_FALSE(std::ifstream(temporaryPath(path)));
+    PatternDatabase db(path);
+
+    GameState gs;
+    for (auto color : colors_list) {
+        for (int value = 1; value <= king_value; ++value)
+            gs.homes[static_cast<int>(color)].acceptCard({color, value});
+    }
+    REQUIRE(db.lowerBound(gs) == 0);
+
+    GameState blocked;
+    blocked.stacks[0].forceCard({Color::Heart, 5});
+    blocked.stacks[0].forceCard({Color::Spade, 9});
+    blocked.stacks[0].forceCard({Color::Heart, 2});
+    blocked.stacks[1].forceCard({Color::Club, 6});
+    blocked.stacks[1].forceCard({Color::Club, 1});
+    // nothing has to step aside, but it is not solved yet
+    REQUIRE(db.lowerBound(blocked) == 1);
+
+    // the 3s have to make way for the 2s below them
+    blocked.stacks[2].forceCard({Color::Diamond, 2});
+    blocked.stacks[2].forceCard({Color::Diamond, 3});
+    blocked.stacks[3].forceCard({Color::Spade, 2});
+    blocked.stacks[3].forceCard({Color::Heart, 9});
+    blocked.stacks[3].forceCard({Color::Spade, 3});
+    REQUIRE(db.lowerBound(blocked) == 2);
+
+    // windows of one suit do not see each other
+    blocked.stacks[4].forceCard({Color::Spade, 4});
+    blocked.stacks[4].forceCard({Color::Spade, 12});
+    REQUIRE(db.lowerBound(blocked) == 2);
+
+    // the 5 only waits for cards which are not home yet
+    blocked.stacks[5].forceCard({Color::Club, 3});
+    blocked.stacks[5].forceCard({Color::Club, 5});
+    REQUIRE(db.lowerBound(blocked) == 3);
+    blocked.homes[0].acceptCard({Color::Club, 1});
+    blocked.homes[0].acceptCard({Color::Club, 2});
+    blocked.homes[0].acceptCard({Color::Club, 3});
+    REQUIRE(db.lowerBound(blocked) == 2);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Move trail and incremental heuristic") {
+    GameState gs;
+    gs.stacks[0].forceCard({Color::Heart, 1});
+    gs.stacks[0].forceCard({Color::Spade, 5});
+    gs.stacks[1].forceCard({Color::Heart, 2});
+    SearchState parent(gs);
+
+    OufOfHome_Pseudo heuristic;
+    double parent_bound = heuristic.distanceLowerBound(parent.gameState());
+
+    MoveTrail trail;
+    SearchAction action({LocationClass::Stacks, 0}, {LocationClass::FreeCells, 0});
+    SearchState child = action.execute(parent, trail);
+
+    // the played card, then both hearts going home on their own
+    REQUIRE(trail.size == 3);
+    REQUIRE(trail.steps[0].color == Color::Spade);
+    REQUIRE(trail.steps[0].to == Location{LocationClass::FreeCells, 0});
+    REQUIRE(trail.steps[1].value == 1);
+    REQUIRE(trail.steps[2].value == 2);
+    REQUIRE(trail.nbToHomes() == 2);
+
+    REQUIRE(heuristic.isIncremental());
+    REQUIRE(heuristic.distanceLowerBoundAfter(parent_bound, child.gameState(), trail) == heuristic.distanceLowerBound(child.gameState()));
+}
+
+TEST_CASE("Blocked cards heuristic") {
+    GameState gs;
+    gs.stacks[0].forceCard({Color::Heart, 3});
+    gs.stacks[0].forceCard({Color::Heart, 7});
+    gs.stacks[0].forceCard({Color::Club, 4});
+    gs.stacks[0].forceCard({Color::Heart, 5});
+    gs.stacks[1].forceCard({Color::Spade, 8});
+    gs.stacks[1].forceCard({Color::Spade, 9});
+
+    BlockedCardsHeuristic blocked;
+    REQUIRE(blocked.distanceLowerBound(gs) == 3);
+
+    // incremental updates agree with full evaluation along random walks
+    std::default_random_engine rng(7);
+    std::vector<int> deck(4 * king_value);
+    std::iota(deck.begin(), deck.end(), 0);
+    MoveTrail trail;
+    for (int deal = 0; deal < 20; ++deal) {
+        std::shuffle(deck.begin(), deck.end(), rng);
+        GameState dealt;
+        for (size_t i = 0; i < deck.size(); ++i)
+            dealt.stacks[i % nb_stacks].forceCard({colors_list[deck[i] / king_value], deck[i] % king_value + 1});
+
+        SearchState state(dealt);
+        double bound = blocked.distanceLowerBound(state.gameState());
+        for (int i = 0; i < 50; ++i) {
+            auto actions = state.actions();
+            if (actions.empty())
+                break;
+            auto pick = std::uniform_int_distribution<size_t>(0, actions.size() - 1)(rng);
+            state = actions[pick].execute(state, trail);
+            bound = blocked.distanceLowerBoundAfter(bound, state.gameState(), trail);
+            REQUIRE(bound == blocked.distanceLowerBound(state.gameState()));
+        }
+    }
+}
+
+TEST_CASE("Max heuristic stops at the cutoff") {
+    GameState gs;
+    gs.stacks[0].forceCard({Color::Heart, 3});
+    gs.stacks[0].forceCard({Color::Heart, 7});
+
+    std::vector<std::unique_ptr<AStarHeuristicItf>> components;
+    components.push_back(std::make_unique<BlockedCardsHeuristic>());
+    components.push_back(std::make_unique<OufOfHome_Pseudo>());
+    MaxHeuristic max(std::move(components));
+
+    REQUIRE(max.distanceLowerBound(gs) == 52);
+    // the cheaper nb_not_home goes first and already reaches the cutoff
+    REQUIRE(max.distanceLowerBoundCutoff(gs, 10) >= 10);
+}
+
+TEST_CASE("Supermoves") {
+    GameState gs;
+    gs.stacks[0].forceCard({Color::Heart, 13});
+    gs.stacks[0].forceCard({Color::Spade, 9});
+    gs.stacks[0].forceCard({Color::Heart, 8});
+    gs.stacks[0].forceCard({Color::Club, 7});
+    gs.stacks[0].forceCard({Color::Diamond, 6});
+    gs.stacks[0].forceCard({Color::Spade, 5});
+    gs.stacks[1].forceCard({Color::Diamond, 10});
+    for (int i = 3; i < nb_stacks; ++i)
+        gs.stacks[i].forceCard({colors_list[i % 4], 11 + i % 3});
+    gs.free_cells[0].acceptCard({Color::Club, 12});
+    gs.free_cells[1].acceptCard({Color::Diamond, 12});
+
+    REQUIRE(orderedRunLength(gs.stacks[0]) == 5);
+    // two free cells and one empty stack
+    REQUIRE(supermoveCapacity(gs, &gs.stacks[1]) == 6);
+    REQUIRE(supermoveCapacity(gs, &gs.stacks[2]) == 3);
+    REQUIRE(supermoveLegal(gs, &gs.stacks[0], &gs.stacks[1], 5));
+    REQUIRE(!supermoveLegal(gs, &gs.stacks[0], &gs.stacks[1], 4));
+    REQUIRE(!supermoveLegal(gs, &gs.stacks[0], &gs.stacks[2], 4));
+    REQUIRE(supermoveLegal(gs, &gs.stacks[0], &gs.stacks[2], 3));
+
+    SearchState state(gs);
+    SearchAction action({LocationClass::Stacks, 0}, {LocationClass::Stacks, 1}, 5);
+    SearchState moved = action.execute(state);
+    REQUIRE(moved.gameState().stacks[1].nbCards() == 6);
+    REQUIRE(moved.gameState().stacks[0].nbCards() == 1);
+
+    // the single-card steps end up in the same state
+    auto steps = action.expand(state);
+    REQUIRE(steps.size() == 11);
+    SearchState replayed(state);
+    for (const auto &step : steps)
+        replayed = step.execute(replayed);
+    REQUIRE(replayed == moved);
+
+    SearchState::enableSupermoves(true);
+    auto actions = state.actions();
+    SearchState::enableSupermoves(false);
+    auto nb_supermoves = std::count_if(actions.begin(), actions.end(), [](const SearchAction &a){return a.nbCards() > 1;});
+    // 2 and 3 cards to the empty stack, 5 cards onto the 10
+    REQUIRE(nb_supermoves == 3);
+    REQUIRE(state.actions().size() + 3 == actions.size());
+}
+
+TEST_CASE("Move pruning") {
+    GameState gs;
+    gs.stacks[0].forceCard({Color::Heart, 13});
+    gs.stacks[0].forceCard({Color::Spade, 9});
+    gs.stacks[1].forceCard({Color::Diamond, 10});
+    gs.stacks[2].forceCard({Color::Club, 12});
+    gs.free_cells[1].acceptCard({Color::Heart, 7});
+    SearchState state(gs);
+
+    auto count_actions = [](PruningRule rule, const SearchState &state) {
+        MovePruning::enable(rule, true);
+        auto before = MovePruning::nbPruned(rule);
+        auto nb_actions = state.actions().size();
+        MovePruning::enable(rule, false);
+        return std::make_pair(nb_actions, MovePruning::nbPruned(rule) - before);
+    };
+
+    auto nb_actions = state.actions().size();
+    // 7H, QC and 10D: 3 empty cells and 5 empty stacks each; 9S: also onto 10D
+    REQUIRE(nb_actions == 33);
+
+    REQUIRE(count_actions(PruningRule::CellToCell, state) == std::make_pair(nb_actions - 3, 3ull));
+    REQUIRE(count_actions(PruningRule::LoneToEmptyStack, state) == std::make_pair(nb_actions - 10, 10ull));
+    // 2 of the 3 empty cells and 4 of the 5 empty stacks, for each of the 4 cards
+    REQUIRE(count_actions(PruningRule::EquivalentEmpty, state) == std::make_pair(nb_actions - 24, 24ull));
+
+    REQUIRE(count_actions(PruningRule::ImmediateUndo, state).second == 0);
+    SearchState moved = SearchAction({LocationClass::Stacks, 1}, {LocationClass::FreeCells, 0}).execute(state);
+    REQUIRE(count_actions(PruningRule::ImmediateUndo, moved).second == 1);
+
+    // weighted anytime A* reopens states with a better g, and still ends up
+    // with the shortest solutions once the weight is down to 1
+    MovePruning::enable(PruningRule::ImmediateUndo, true);
+    EasyProducer producer(4, 8);
+    for (int i = 0; i < 20; ++i) {
+        SearchState init_state(producer.produce());
+        AnytimeAStarSearch anytime(std::make_unique<BlockedCardsHeuristic>(), 5.0, 1.0, std::chrono::milliseconds(0));
+        CHECK(anytime.solve(init_state).size() == BreadthFirstSearch(0).solve(init_state).size());
+    }
+    MovePruning::enable(PruningRule::ImmediateUndo, false);
+}
+
+TEST_CASE("Autoplay modes") {
+    // hearts and diamonds up to 3, clubs up to 2
+    std::array<int, 4> home_values{3, 3, 2, 4};
+    REQUIRE(!autoplaySafe(Color::Spade, 5, home_values, AutoplayMode::Conservative));
+    REQUIRE(autoplaySafe(Color::Spade, 5, home_values, AutoplayMode::Aggressive));
+    home_values[static_cast<int>(Color::Club)] = 1;
+    REQUIRE(!autoplaySafe(Color::Spade, 5, home_values, AutoplayMode::Aggressive));
+    REQUIRE(autoplaySafe(Color::Diamond, 4, home_values, AutoplayMode::Conservative) == false);
+    REQUIRE(autoplaySafe(Color::Heart, 2, home_values, AutoplayMode::Conservative));
+
+    GameState gs;
+    for (auto [color, top] : {std::pair{Color::Heart, 3}, {Color::Diamond, 3}, {Color::Club, 2}, {Color::Spade, 4}}) {
+        for (int value = 1; value <= top; ++value)
+            gs.homes[static_cast<int>(color)].acceptCard({color, value});
+    }
+    gs.stacks[0].forceCard({Color::Spade, 5});
+    gs.stacks[1].forceCard({Color::Diamond, 13});
+    gs.stacks[1].forceCard({Color::Club, 12});
+    SearchState state(gs);
+    SearchAction action({LocationClass::Stacks, 1}, {LocationClass::FreeCells, 0});
+
+    // only Horne's rule lets the 5 of spades go
+    REQUIRE(action.execute(state).gameState().stacks[0].nbCards() == 1);
+    SearchState::setAutoplay(AutoplayMode::Aggressive);
+    REQUIRE(action.execute(state).gameState().stacks[0].nbCards() == 0);
+
+    gs.stacks[2].forceCard({Color::Heart, 9});
+    gs.stacks[2].forceCard({Color::Heart, 10});
+    REQUIRE(!isWonEndgame(gs));
+    gs.stacks[2].getCard();
+    REQUIRE(isWonEndgame(gs));
+    SearchState::setAutoplay(AutoplayMode::Conservative);
+}
+
+TEST_CASE("Card index") {
+    GameState gs;
+    gs.stacks[2].forceCard({Color::Club, 9});
+    gs.stacks[2].forceCard({Color::Heart, 8});
+    gs.stacks[2].forceCard({Color::Spade, 7});
+    gs.free_cells[3].acceptCard({Color::Diamond, 4});
+    gs.homes[1].acceptCard({Color::Spade, 1});
+
+    REQUIRE(gs.slotOf({Color::Heart, 8}) == nb_freecells + 2);
+    REQUIRE(gs.depthOf({Color::Heart, 8}) == 1);
+    REQUIRE(gs.nbCardsAbove({Color::Club, 9}) == 2);
+    REQUIRE(gs.slotOf({Color::Diamond, 4}) == 3);
+    REQUIRE(gs.slotOf({Color::Diamond, 5}) == CardIndex::nowhere);
+    REQUIRE(gs.homeValue(Color::Spade) == 1);
+    REQUIRE(findHomeFor(gs, {Color::Heart, 1}) == gs.homes.begin());
+    REQUIRE(findHomeFor(gs, {Color::Spade, 2}) == gs.homes.begin() + 1);
+
+    // copies get their own index, which follows their moves
+    GameState copy(gs);
+    move(&copy.stacks[2], &copy.free_cells[0]);
+    REQUIRE(copy.slotOf({Color::Spade, 7}) == 0);
+    REQUIRE(gs.slotOf({Color::Spade, 7}) == nb_freecells + 2);
+
+    // and stays the same as a rebuilt one along a few moves
+    SearchState state(gs);
+    for (int i = 0; i < 10; ++i)
+        state = state.actions()[0].execute(state);
+    GameState rebuilt(state.gameState());
+    rebuilt.reindex();
+    REQUIRE(rebuilt.index.slot == state.gameState().index.slot);
+    REQUIRE(rebuilt.index.depth == state.gameState().index.depth);
+    REQUIRE(rebuilt.index.home_value == state.gameState().index.home_value);
+
+    // moving swaps the indexes along with the cards
+    GameState moved_from(gs);
+    GameState moved_to(copy);
+    moved_to = std::move(moved_from);
+    REQUIRE(moved_to.slotOf({Color::Spade, 7}) == nb_freecells + 2);
+    REQUIRE(moved_from.slotOf({Color::Spade, 7}) == 0);
+    for (auto *moved : {&moved_to, &moved_from}) {
+        GameState reindexed(*moved);
+        reindexed.reindex();
+        REQUIRE(reindexed.index.slot == moved->index.slot);
+        REQUIRE(reindexed.index.depth == moved->index.depth);
+        REQUIRE(reindexed.index.home_value == moved->index.home_value);
+    }
+}
+
+TEST_CASE("Bitmask move generation") {
+    // same moves in the same order as availableMoves(), aces to any empty home included
+    std::default_random_engine rng(11);
+    for (int deal = 0; deal < 20; ++deal) {
+        GameState dealt;
+        initializeFullRandom(&dealt, rng);
+        SearchState state(dealt);
+        for (int i = 0; i < 30; ++i) {
+            const auto &gs = state.gameState();
+            auto raw_moves = availableMoves(gs.non_homes.begin(), gs.non_homes.end(), gs.all_storage.begin(), gs.all_storage.end());
+            SlotMoveBuffer moves;
+            int nb_moves = legalMoves(gs, moves);
+
+            std::vector<std::pair<Location, Location>> expected, generated;
+            for (const auto &raw_move : raw_moves)
+                expected.emplace_back(locFromPtr(gs, raw_move.first), locFromPtr(gs, raw_move.second));
+            for (int j = 0; j < nb_moves; ++j)
+                generated.emplace_back(locFromSlot(moves[j].from), locFromSlot(moves[j].to));
+            REQUIRE(generated == expected);
+
+            auto actions = state.actions();
+            if (actions.empty())
+                break;
+            state = actions[std::uniform_int_distribution<size_t>(0, actions.size() - 1)(rng)].execute(state);
+        }
+    }
+}
+
+TEST_CASE("Actions into a fixed buffer") {
+    std::default_random_engine rng(5);
+    GameState dealt;
+    initializeFullRandom(&dealt, rng);
+    SearchState state(dealt);
+
+    ActionList buffer;
+    buffer.push_back({{LocationClass::Stacks, 0}, {LocationClass::Stacks, 1}});
+    state.actions(buffer);
+    auto actions = state.actions();
+
+    REQUIRE(buffer.size() == actions.size());
+    for (size_t i = 0; i < actions.size(); ++i) {
+        REQUIRE(buffer[i].from() == actions[i].from());
+        REQUIRE(buffer[i].to() == actions[i].to());
+    }
+}
+
+TEST_CASE("Playout board make and unmake") {
+    std::default_random_engine rng(7);
+    GameState dealt;
+    initializeFullRandom(&dealt, rng);
+    PlayoutBoard board(dealt, 300);
+
+    auto legal = [&] {
+        PlayoutBoard::MoveBuffer buffer;
+        int nb_moves = board.legalMoves(buffer);
+        std::vector<std::pair<int, int>> moves;
+        for (int i = 0; i < nb_moves; ++i)
+            moves.emplace_back(buffer[i].from, buffer[i].to);
+        return moves;
+    };
+
+    struct Snapshot {
+        GameState state;
+        int nb_home;
+        std::vector<std::pair<int, int>> moves;
+    };
+    std::vector<Snapshot> snapshots;
+    while (snapshots.size() < board.maxDepth() && !board.isFinal()) {
+        auto moves = legal();
+        if (moves.empty())
+            break;
+        snapshots.push_back({board.gameState(), board.nbHome(), moves});
+        auto move = moves[rng() % moves.size()];
+        board.make({std::uint8_t(move.first), std::uint8_t(move.second)});
+    }
+    REQUIRE(snapshots.size() > 50);
+    CHECK(board.depth() == snapshots.size());
+
+    // every unmake gives back the board exactly as it was before the make
+    while (!snapshots.empty()) {
+        board.unmake();
+        CHECK(board.gameState() == snapshots.back().state);
+        CHECK(board.nbHome() == snapshots.back().nb_home);
+        CHECK(legal() == snapshots.back().moves);
+        snapshots.pop_back();
+    }
+    CHECK(board.depth() == 0);
+    CHECK(board.gameState() == dealt);
+}
+
+TEST_CASE("Nested Monte Carlo search") {
+    EasyProducer producer(11, 10);
+    for (int i = 0; i < 3; ++i) {
+        SearchState init_state(producer.produce());
+        NestedMonteCarloSearch nmcs(1, 300);
+        auto solution = nmcs.solve(init_state);
+        REQUIRE_FALSE(solution.empty());
+
+        SearchState played(init_state);
+        for (const auto &action : solution)
+            played = action.execute(played);
+        CHECK(played.isWon());
+    }
+}
+
+TEST_CASE("Thread pool") {
+    ThreadPool pool(4);
+    CHECK(pool.size() == 4);
+
+    // runs every task exactly once, loop after loop
+    for (std::size_t nb_tasks : {0, 1, 3, 100}) {
+        std::vector<std::atomic<int>> nb_calls(nb_tasks);
+        pool.parallelFor(nb_tasks, [&](std::size_t task) {nb_calls[task]++;});
+        for (const auto &nb : nb_calls)
+            CHECK(nb == 1);
+    }
+}
+
+TEST_CASE("Dummy search does not depend on the number of threads") {
+    EasyProducer producer(12, 3);
+    int nb_solved = 0;
+    for (int i = 0; i < 5; ++i) {
+        SearchState init_state(producer.produce());
+        auto single = DummySearch(200, 64, 1).solve(init_state);
+        auto parallel = DummySearch(200, 64, 4).solve(init_state);
+
+        REQUIRE(single.size() == parallel.size());
+        for (size_t j = 0; j < single.size(); ++j) {
+            CHECK(single[j].from() == parallel[j].from());
+            CHECK(single[j].to() == parallel[j].to());
+            CHECK(single[j].nbCards() == parallel[j].nbCards());
+        }
+        if (!single.empty())
+            nb_solved++;
+    }
+    CHECK(nb_solved > 0);
+}
+
+TEST_CASE("Deal corpus") {
+    SECTION("encoding round-trips random and easy deals") {
+        RandomProducer random(7);
+        EasyProducer easy(7, 30);
+        for (int i = 0; i < 10; ++i) {
+            for (InitialStateProducerItf *producer : std::vector<InitialStateProducerItf *>{&random, &easy}) {
+                auto gs = producer->produce();
+                auto decoded = decodeDeal(encodeDeal(gs).data());
+                CHECK(decoded == gs);
+                CHECK(decoded.index.slot == gs.index.slot);
+                CHECK(decoded.index.home_slot == gs.index.home_slot);
+            }
+        }
+    }
+
+    SECTION("corpus gives back the produced deals") {
+        const std::string path = "test-bin.deals";
+        RandomProducer producer(11);
+        writeDealCorpus(path, producer, 20);
+
+        RandomProducer reference(11);
+        CorpusProducer corpus(path);
+        REQUIRE(corpus.nbDeals() == 20);
+        for (int i = 0; i < 20; ++i)
+            CHECK(corpus.produce() == reference.produce());
+        CHECK_THROWS_AS(corpus.produce(), std::out_of_range);
+        CHECK_NOTHROW(corpus.verify());
+
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekg(100);
+            char byte = file.get();
+            file.seekp(100);
+            file.put(byte ^ 1);
+        }
+        // opening does not read the deals, the broken one is found when decoded
+        CorpusProducer corrupted(path);
+        CHECK_NOTHROW(corrupted.produceAt(0));
+        CHECK_THROWS_AS(corrupted.produceAt(1), std::runtime_error);
+        CHECK_THROWS_AS(corrupted.verify(), std::runtime_error);
+        CHECK_NOTHROW(CorpusProducer(path).produceAt(19));
+
+        std::remove(path.c_str());
+    }
+}
+
+TEST_CASE("Microsoft deals") {
+    auto stackRepresentation = [](const WorkStack &stack) {
+        std::string repr;
+        for (const auto &card : stack.storage())
+            repr += cardRepresentation(card) + " ";
+        return repr;
+    };
+
+    auto deal_1 = MicrosoftProducer::deal(1);
+    CHECK(stackRepresentation(deal_1.stacks[0]) == "Jd Kd 2s 4c 3s 6d 6s ");
+    CHECK(stackRepresentation(deal_1.stacks[7]) == "5h 3h 3c 7s 7d 10c ");
+
+    auto deal_617 = MicrosoftProducer::deal(617);
+    CHECK(stackRepresentation(deal_617.stacks[0]) == "7d 10d 10h Kd 4c 4s Jd ");
+    CHECK(stackRepresentation(deal_617.stacks[4]) == "5s 6d 6s 8s 7c Jc ");
+
+    MicrosoftProducer producer(616, 617);
+    producer.produce();
+    CHECK(producer.produce() == deal_617);
+    CHECK_THROWS_AS(producer.produce(), std::out_of_range);
+}
+
+TEST_CASE("Text deals") {
+    SECTION("writing and reading round-trips") {
+        std::stringstream text;
+        std::vector<GameState> deals;
+        EasyProducer producer(3, 60);
+        for (int i = 0; i < 10; ++i) {
+            deals.push_back(producer.produce());
+            writeTextDeal(text, deals.back());
+        }
+
+        TextDealReader reader(text);
+        for (const auto &deal : deals) {
+            auto read = reader.next();
+            REQUIRE(read.has_value());
+            CHECK(*read == deal);
+        }
+        CHECK_FALSE(reader.next().has_value());
+    }
+
+    SECTION("reads the common layout") {
+        // Microsoft deal 1 with a few cards moved around
+        std::stringstream text(
+            "# a position with cards home and in the cells\n"
+            "\n"
+            "Foundations: H-A C-0 D-0 S-0\n"
+            "FreeCells: 8c - - 10c\n"
+            "JD KD 2S 4C 3S 6D 6S\n"
+            ": 2D KC KS 5C TD 8S 9C\n"
+            ": 9H 9S 9D TS 4S 8D 2H\n"
+            ": JC 5S QD QH TH QS 6H\n"
+            ": 5D AD JS 4H 8H 6C 7H QC AS AC 2C 3D\n"
+            ":\n"
+            ": 7C KH 4D JH\n"
+            ": 5H 3H 3C 7S 7D\n"
+        );
+        TextDealReader reader(text);
+        auto gs = reader.next();
+        REQUIRE(gs.has_value());
+        CHECK(gs->homes[0].topCard() == Card{Color::Heart, 1});
+        CHECK_FALSE(gs->homes[1].topCard().has_value());
+        CHECK(gs->free_cells[0].topCard() == Card{Color::Club, 8});
+        CHECK(gs->free_cells[3].topCard() == Card{Color::Club, 10});
+        CHECK(gs->stacks[0].nbCards() == 7);
+        CHECK(gs->stacks[5].nbCards() == 0);
+        CHECK(gs->stacks[7].topCard() == Card{Color::Diamond, 7});
+        CHECK_FALSE(reader.next().has_value());
+    }
+
+    SECTION("rejects incomplete deals") {
+        std::stringstream text("AH 2H\n\nKS\n");
+        TextDealReader reader(text);
+        CHECK_THROWS_WITH(reader.next(), "line 2: the deal ends after 1 stacks");
+
+        std::stringstream twice("Foundations: H-2\n: AH\n");
+        TextDealReader twice_reader(twice);
+        CHECK_THROWS_WITH(twice_reader.next(), "line 2: card AH dealt twice");
+
+        std::stringstream unknown(": AH 1H\n");
+        TextDealReader unknown_reader(unknown);
+        CHECK_THROWS_WITH(unknown_reader.next(), "line 1: unknown card '1H'");
+
+        std::stringstream short_foundation("Foundations: H\n: AH\n");
+        TextDealReader short_reader(short_foundation);
+        CHECK_THROWS_WITH(short_reader.next(), "line 1: unknown foundation 'H'");
+    }
+
+    SECTION("counts the deals of a file") {
+        const std::string path = "test-bin.deals";
+        {
+            std::ofstream out(path);
+            EasyProducer producer(3, 60);
+            for (int i = 0; i < 3; ++i)
+                writeTextDeal(out, producer.produce());
+        }
+        CHECK(countTextDeals(path) == 3);
+        std::remove(path.c_str());
+        CHECK_THROWS_AS(countTextDeals(path), std::runtime_error);
+    }
+}
+
+TEST_CASE("Deal pipeline") {
+    SECTION("indexed deals do not depend on the number of threads") {
+        EasyProducer producer(5, 40);
+        std::vector<EncodedDeal> expected;
+        for (int i = 0; i < 30; ++i)
+            expected.push_back(encodeDeal(producer.produceAt(i)));
+        std::sort(expected.begin(), expected.end());
+
+        for (size_t nb_threads : {1, 3}) {
+            DealPipeline pipeline(producer, 30, nb_threads, 4);
+            std::vector<EncodedDeal> popped;
+            while (auto deal = pipeline.pop())
+                popped.push_back(encodeDeal(deal->state));
+            std::sort(popped.begin(), popped.end());
+            CHECK(popped == expected);
+        }
+    }
+
+    SECTION("other producers keep their order") {
+        MicrosoftProducer reference(1, 10);
+        // hides the indexed deals
+        struct InOrder : public InitialStateProducerItf {
+            MicrosoftProducer deals{1, 10};
+            GameState produce() override {return deals.produce();}
+        } producer;
+
+        DealPipeline pipeline(producer, 10, 3, 2);
+        for (int i = 0; i < 10; ++i) {
+            auto deal = pipeline.pop();
+            REQUIRE(deal.has_value());
+            CHECK(deal->state == reference.produce());
+        }
+        CHECK_FALSE(pipeline.pop().has_value());
+    }
+
+    SECTION("errors reach the consumer") {
+        struct InOrder : public InitialStateProducerItf {
+            MicrosoftProducer deals{1, 5};
+            GameState produce() override {return deals.produce();}
+        } in_order;
+
+        DealPipeline pipeline(in_order, 8, 2, 3);
+        for (int i = 0; i < 5; ++i)
+            CHECK(pipeline.pop().has_value());
+        CHECK_THROWS_AS(pipeline.pop(), std::out_of_range);
+    }
+}
+
+TEST_CASE("Known solutions of easy deals") {
+    EasyProducer with_solutions(9, 15);
+    EasyProducer plain(9, 15);
+
+    int nb_known = 0;
+    for (int i = 0; i < 20; ++i) {
+        auto deal = with_solutions.produceDeal();
+        CHECK(deal.state == plain.produce());
+        if (!deal.known_solution.has_value())
+            continue;
+        nb_known++;
+
+        CHECK(isSolution(deal.state, *deal.known_solution));
+
+        SearchState init_state(deal.state);
+        auto actions = replaySolution(init_state, *deal.known_solution);
+        REQUIRE(actions.has_value());
+        CHECK(actions->size() <= deal.known_solution->size());
+        SearchState played(init_state);
+        for (const auto &action : *actions)
+            played = action.execute(played);
+        CHECK(played.isFinal());
+    }
+    CHECK(nb_known > 10);
+
+    // every card dealt straight from home, nothing forced
+    auto deal = EasyProducer(9, 0).produceDeal();
+    REQUIRE(deal.known_solution.has_value());
+    CHECK(deal.known_solution->size() == 4 * king_value);
+
+    auto broken = *deal.known_solution;
+    std::swap(broken.front(), broken.back());
+    CHECK_FALSE(isSolution(deal.state, broken));
+}
+
+TEST_CASE("Depth-first branch and bound") {
+    auto isSolutionOf = [](const SearchState &init_state, const std::vector<SearchAction> &solution) {
+        SearchState played(init_state);
+        for (const auto &action : solution)
+            played = action.execute(played);
+        return played.isFinal();
+    };
+
+    EasyProducer producer(21, 14);
+    for (int i = 0; i < 5; ++i) {
+        auto deal = producer.produceDeal();
+        SearchState init_state(deal.state);
+
+        AnytimeAStarSearch a_star(std::make_unique<BlockedCardsHeuristic>(), 1.0, 1.0, std::chrono::milliseconds(0));
+        auto optimal = a_star.solve(init_state).size();
+
+        // with an admissible heuristic, either way ends up optimal
+        for (size_t tt_size : {0, 100'000}) {
+            DepthFirstBranchAndBound dfbnb(std::make_unique<BlockedCardsHeuristic>(), 200, tt_size, std::chrono::milliseconds(0));
+            std::vector<size_t> published;
+            dfbnb.onSolution([&](const std::vector<SearchAction> &solution) {published.push_back(solution.size());});
+
+            auto solution = dfbnb.solve(init_state);
+            CHECK(solution.size() == optimal);
+            CHECK(isSolutionOf(init_state, solution));
+            REQUIRE_FALSE(published.empty());
+            CHECK(std::is_sorted(published.rbegin(), published.rend()));
+            CHECK(published.back() == optimal);
+        }
+
+        // an upper bound from a known solution is beaten down to the optimal length
+        REQUIRE(deal.known_solution.has_value());
+        auto known = replaySolution(init_state, *deal.known_solution);
+        REQUIRE(known.has_value());
+        DepthFirstBranchAndBound bounded(std::make_unique<BlockedCardsHeuristic>(), 200, 0, std::chrono::milliseconds(0));
+        bounded.setUpperBound(known->size(), *known);
+        auto improved = bounded.solve(init_state);
+        CHECK(improved.size() == std::min(optimal, known->size()));
+        CHECK(isSolutionOf(init_state, improved));
+
+        // one which can not be beaten gives back its solution
+        auto shortest = BreadthFirstSearch(0).solve(init_state);
+        REQUIRE(shortest.size() == optimal);
+        bounded.setUpperBound(optimal, shortest);
+        auto given_back = bounded.solve(init_state);
+        CHECK(given_back.size() == optimal);
+        CHECK(isSolutionOf(init_state, given_back));
+        // and only for one solve()
+        CHECK(bounded.solve(init_state).size() == optimal);
+    }
+}
+
+TEST_CASE("Taking moves back") {
+    EasyProducer producer(7, 10);
+    for (int i = 0; i < 5; ++i) {
+        GameState gs = producer.produce();
+        SlotMoveBuffer moves;
+        int nb_moves = reverseMoves(gs, moves);
+        REQUIRE(nb_moves > 0);
+        for (int j = 0; j < nb_moves; ++j) {
+            GameState predecessor(gs);
+            unplayMove(&predecessor, moves[j]);
+            CHECK_FALSE(predecessor == gs);
+            // playing the move again gets back where it started
+            auto from = predecessor.all_storage[moves[j].from];
+            auto to = predecessor.all_storage[moves[j].to];
+            REQUIRE(moveLegal(from, to));
+            move(from, to);
+            CHECK(predecessor == gs);
+        }
+    }
+}
+
+TEST_CASE("Canonical keys") {
+    GameState gs = MicrosoftProducer::deal(1);
+    GameState other(gs);
+    forceMove(&gs.stacks[0], &gs.stacks[1]);
+    gs.stacks[2].getCard();
+    other.stacks[2].getCard();
+    CHECK(canonicalKey(gs) != canonicalKey(other));
+
+    GameState a(other), b(other);
+    a.free_cells[0].acceptCard(*a.stacks[3].getCard());
+    b.free_cells[2].acceptCard(*b.stacks[3].getCard());
+    CHECK_FALSE(a == b);
+    CHECK(canonicalKey(a) == canonicalKey(b));
+}
+
+TEST_CASE("Settled predecessors") {
+    GameState solved;
+    for (size_t i = 0; i < colors_list.size(); ++i) {
+        for (int j = 1; j <= king_value; ++j)
+            solved.homes[i].acceptCard({colors_list[i], j});
+    }
+
+    // the queen under the king of the same suit: moving the king lets both go home
+    GameState two_out(solved);
+    auto king = *two_out.homes[0].getCard();
+    auto queen = *two_out.homes[0].getCard();
+    two_out.stacks[0].forceCard(queen);
+    two_out.stacks[0].forceCard(king);
+    REQUIRE(SearchState::settled(two_out).gameState() == two_out);
+
+    auto key = canonicalKey(two_out);
+    for (int max_taken = 0; max_taken <= 2; ++max_taken) {
+        auto predecessors = settledPredecessors(SearchState(solved), max_taken);
+        bool found = false;
+        for (const auto &predecessor : predecessors) {
+            // each of them is settled and leads to the solved state
+            CHECK(SearchState::settled(predecessor.state).gameState() == predecessor.state);
+            CHECK(predecessor.action.execute(SearchState(predecessor.state)).isWon());
+            found = found || canonicalKey(predecessor.state) == key;
+        }
+        // the king goes home on its own after the queen, both are taken back out
+        CHECK(found == (max_taken >= 2));
+    }
+
+    // with supermoves, runs are taken back at once too
+    SearchState::enableSupermoves(true);
+    EasyProducer producer(5, 10);
+    bool any_run = false;
+    for (int i = 0; i < 5; ++i) {
+        auto state = SearchState::settled(producer.produce());
+        auto target = canonicalKey(state.gameState());
+        for (const auto &predecessor : settledPredecessors(state, 1)) {
+            CHECK(canonicalKey(predecessor.action.execute(SearchState(predecessor.state)).gameState()) == target);
+            any_run = any_run || predecessor.action.nbCards() > 1;
+        }
+    }
+    CHECK(any_run);
+    SearchState::enableSupermoves(false);
+
+    // the way back finds the action again
+    auto action = actionLeadingTo(SearchState(two_out), canonicalKey(solved), 1);
+    REQUIRE(action.has_value());
+    CHECK(action->execute(SearchState(two_out)).isWon());
+}
+
+TEST_CASE("Bidirectional search") {
+    EasyProducer producer(21, 10);
+    for (int i = 0; i < 5; ++i) {
+        SearchState init_state(producer.produce());
+        BidirectionalSearch bidir(1'000'000, 2);
+        auto solution = bidir.solve(init_state);
+        REQUIRE_FALSE(solution.empty());
+        // as short as the plain breadth-first search finds
+        CHECK(solution.size() == BreadthFirstSearch(0).solve(init_state).size());
+
+        SearchState played(init_state);
+        for (const auto &action : solution)
+            played = action.execute(played);
+        CHECK(played.isWon());
+    }
+
+    // states the backward half reaches in two layers
+    GameState solved;
+    for (size_t i = 0; i < colors_list.size(); ++i) {
+        for (int j = 1; j <= king_value; ++j)
+            solved.homes[i].acceptCard({colors_list[i], j});
+    }
+    auto first_layer = settledPredecessors(SearchState(solved), 2);
+    REQUIRE(first_layer.size() > 2);
+    for (size_t i = 0; i < first_layer.size(); i += first_layer.size() / 3) {
+        auto second_layer = settledPredecessors(SearchState(first_layer[i].state), 2);
+        REQUIRE_FALSE(second_layer.empty());
+        for (size_t j = 0; j < std::min<size_t>(second_layer.size(), 3); ++j) {
+            SearchState init_state(second_layer[j].state);
+            auto solution = BidirectionalSearch(1'000'000, 2).solve(init_state);
+            REQUIRE(solution.size() <= 2);
+            CHECK(solution.size() == BreadthFirstSearch(0).solve(init_state).size());
+
+            SearchState played(init_state);
+            for (const auto &action : solution)
+                played = action.execute(played);
+            CHECK(played.isWon());
+        }
+    }
+
+    BidirectionalSearch tiny(10, 2);
+    CHECK(tiny.solve(SearchState(MicrosoftProducer::deal(1))).empty());
+}
+
+TEST_CASE("Endgame database") {
+    const std::string path = "test-bin.endgame";
+    EndgameDatabase::build(path, 4);
+    CHECK_FALSE(std::ifstream(temporaryPath(path)));
+    auto db = std::make_shared<const EndgameDatabase>(path);
+    REQUIRE(db->maxCards() == 4);
+    REQUIRE(db->nbPositions() > 0);
+
+    GameState solved;
+    for (size_t i = 0; i < colors_list.size(); ++i) {
+        for (int value = 1; value <= king_value; ++value)
+            solved.homes[i].acceptCard({colors_list[i], value});
+    }
+    CHECK(db->distance(solved) == 0);
+    CHECK_FALSE(db->distance(MicrosoftProducer::deal(1)).has_value());
+
+    // positions near the end, by taking moves back from the solved state
+    std::default_random_engine rng(5);
+    std::vector<SearchState> endgames;
+    while (endgames.size() < 20) {
+        GameState gs(solved);
+        SlotMoveBuffer moves;
+        for (int i = 0; i < 6; ++i) {
+            int nb_moves = reverseMoves(gs, moves);
+            unplayMove(&gs, moves[std::uniform_int_distribution<int>(0, nb_moves - 1)(rng)]);
+        }
+        auto state = SearchState::settled(gs);
+        int nb_out = 0;
+        for (auto color : colors_list)
+            nb_out += king_value - state.gameState().homeValue(color);
+        if (nb_out > 0 && nb_out <= 4)
+            endgames.push_back(state);
+    }
+
+    for (const auto &state : endgames) {
+        BreadthFirstSearch bfs(0);
+        auto optimal = bfs.solve(state);
+        REQUIRE(db->distance(state.gameState()) == static_cast<int>(optimal.size()));
+    }
+
+    // searches stop at the first position of the database, the rest is played from it
+    SearchState::setEndgameDatabase(db);
+    EasyProducer producer(3, 10);
+    for (int i = 0; i < 3; ++i) {
+        SearchState init_state(producer.produce());
+        BeamSearch beam(std::make_unique<BlockedCardsHeuristic>(), 10, 100);
+        auto solution = completeSolution(init_state, beam.solve(init_state));
+
+        SearchState played(init_state);
+        for (const auto &action : solution)
+            played = action.execute(played);
+        CHECK(played.isWon());
+    }
+    for (const auto &state : endgames) {
+        CHECK(state.isFinal());
+        CHECK(state.distanceLeft() == *db->distance(state.gameState()));
+        CHECK(completeSolution(state, {}).size() == static_cast<size_t>(*db->distance(state.gameState())));
+    }
+    SearchState::setEndgameDatabase(nullptr);
+
+    // optimal solvers stay optimal, counting the actions the database leaves
+    std::vector<SearchState> farther;
+    while (farther.size() < 5) {
+        GameState gs(solved);
+        SlotMoveBuffer moves;
+        for (int i = 0; i < 12; ++i) {
+            int nb_moves = reverseMoves(gs, moves);
+            unplayMove(&gs, moves[std::uniform_int_distribution<int>(0, nb_moves - 1)(rng)]);
+        }
+        auto state = SearchState::settled(gs);
+        int nb_out = 0;
+        for (auto color : colors_list)
+            nb_out += king_value - state.gameState().homeValue(color);
+        if (nb_out > 4 && nb_out <= 8)
+            farther.push_back(state);
+    }
+    for (const auto &state : farther) {
+        auto optimal = BreadthFirstSearch(0).solve(state).size();
+
+        SearchState::setEndgameDatabase(db);
+        CHECK(completeSolution(state, BreadthFirstSearch(0).solve(state)).size() == optimal);
+        DepthFirstBranchAndBound dfbnb(std::make_unique<BlockedCardsHeuristic>(), 100, 0, std::chrono::milliseconds(0));
+        CHECK(completeSolution(state, dfbnb.solve(state)).size() == optimal);
+        AnytimeAStarSearch anytime(std::make_unique<BlockedCardsHeuristic>(), 1.0, 1.0, std::chrono::milliseconds(0));
+        CHECK(completeSolution(state, anytime.solve(state)).size() == optimal);
+
+        NestedMonteCarloSearch nmcs(1, 100);
+        SearchState played(state);
+        for (const auto &action : completeSolution(state, nmcs.solve(state)))
+            played = action.execute(played);
+        CHECK(played.isWon());
+        SearchState::setEndgameDatabase(nullptr);
+    }
+
+    CHECK_THROWS_AS(EndgameDatabase::open(path, 5), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Perimeter search") {
+    GameState solved;
+    for (size_t i = 0; i < colors_list.size(); ++i) {
+        for (int value = 1; value <= king_value; ++value)
+            solved.homes[i].acceptCard({colors_list[i], value});
+    }
+    auto first_layer = settledPredecessors(SearchState(solved), 2);
+    REQUIRE(first_layer.size() > 2);
+
+    // every state one action back is in it, and is won through it
+    auto perimeter = Perimeter::around(1, 100'000, 2);
+    REQUIRE(perimeter->depth() == 1);
+    CHECK(perimeter->size() <= first_layer.size() + 1);
+    CHECK(Perimeter::around(1, 100'000, 2) == perimeter);
+    for (const auto &predecessor : first_layer) {
+        SearchState state(predecessor.state);
+        REQUIRE(perimeter->distance(state) == 1);
+        auto tail = perimeter->finish(state);
+        REQUIRE(tail.has_value());
+        REQUIRE(tail->size() == 1);
+        CHECK(tail->front().execute(state).isWon());
+    }
+    CHECK_FALSE(perimeter->distance(SearchState(MicrosoftProducer::deal(1))).has_value());
+    CHECK_FALSE(perimeter->finish(SearchState(MicrosoftProducer::deal(1))).has_value());
+
+    // a budget stops the perimeter short
+    auto small = Perimeter::around(2, 50, 2);
+    CHECK(small->depth() <= 1);
+    CHECK(small->size() <= 50);
+
+    // the second layer in part, its states taking two actions
+    auto deeper = Perimeter::around(2, 5'000, 2);
+    REQUIRE(deeper->depth() == 2);
+    int nb_checked = 0;
+    for (size_t i = 0; i < first_layer.size(); i += first_layer.size() / 3) {
+        for (const auto &predecessor : settledPredecessors(SearchState(first_layer[i].state), 2)) {
+            SearchState state(predecessor.state);
+            auto distance = deeper->distance(state);
+            if (!distance)
+                continue;
+            CHECK(*distance <= 2);
+            auto tail = deeper->finish(state);
+            REQUIRE(tail.has_value());
+            CHECK(tail->size() == static_cast<size_t>(*distance));
+            SearchState played(state);
+            for (const auto &action : *tail)
+                played = action.execute(played);
+            CHECK(played.isWon());
+            ++nb_checked;
+        }
+    }
+    CHECK(nb_checked > 0);
+
+    // the perimeter is reached on the way to the end, and nothing shorter is missed
+    EasyProducer producer(21, 10);
+    PerimeterSearch search(std::make_unique<BlockedCardsHeuristic>(), 2, 5'000, 2);
+    for (int i = 0; i < 5; ++i) {
+        SearchState init_state(producer.produce());
+        auto solution = search.solve(init_state);
+        REQUIRE_FALSE(solution.empty());
+        CHECK(solution.size() == BreadthFirstSearch(0).solve(init_state).size());
+
+        SearchState played(init_state);
+        for (const auto &action : solution)
+            played = action.execute(played);
+        CHECK(played.isWon());
+    }
+}
+
+TEST_CASE("Solution cache") {
+    const std::string path = "test-bin.cache";
+    std::remove(path.c_str());
+
+    EasyProducer producer(4, 10);
+    std::vector<GameState> deals;
+    std::vector<SolutionCache::Entry> entries;
+    for (int i = 0; i < 3; ++i) {
+        deals.push_back(producer.produce());
+        SearchState init_state(deals.back());
+        BeamSearch beam(std::make_unique<BlockedCardsHeuristic>(), 10, 100);
+        auto solution = beam.solve(init_state);
+        entries.push_back({true, solution, 100ull + i, std::chrono::microseconds(10 + i), std::chrono::microseconds(5)});
+    }
+
+    {
+        SolutionCache cache(path, "beam");
+        CHECK(cache.size() == 0);
+        for (size_t i = 0; i < deals.size(); ++i)
+            cache.store(deals[i], entries[i]);
+        // a later outcome replaces the earlier one
+        cache.store(deals[2], {false, {}, 7, std::chrono::microseconds(1), std::chrono::microseconds(1)});
+    }
+
+    SolutionCache cache(path, "beam");
+    REQUIRE(cache.size() == 3);
+    for (size_t i = 0; i < 2; ++i) {
+        auto entry = cache.find(deals[i]);
+        REQUIRE(entry.has_value());
+        CHECK(entry->solved);
+        CHECK(entry->nb_expanded == entries[i].nb_expanded);
+        CHECK(entry->time_taken == entries[i].time_taken);
+        CHECK(entry->first_solution_time == entries[i].first_solution_time);
+
+        // the actions come back as they went in, and still win
+        REQUIRE(entry->solution.size() == entries[i].solution.size());
+        SearchState played(deals[i]);
+        for (size_t j = 0; j < entry->solution.size(); ++j) {
+            CHECK(entry->solution[j].from() == entries[i].solution[j].from());
+            CHECK(entry->solution[j].to() == entries[i].solution[j].to());
+            CHECK(entry->solution[j].nbCards() == entries[i].solution[j].nbCards());
+            played = entry->solution[j].execute(played);
+        }
+        CHECK(played.isFinal());
+    }
+    auto replaced = cache.find(deals[2]);
+    REQUIRE(replaced.has_value());
+    CHECK_FALSE(replaced->solved);
+    CHECK(replaced->nb_expanded == 7);
+    CHECK_FALSE(cache.find(producer.produce()).has_value());
+
+    // other configurations do not see them
+    CHECK(SolutionCache(path, "a_star").size() == 0);
+    CHECK(SolutionCache(path, "beam").size() == 3);
+
+    // a record cut short is dropped
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out << "cut short";
+    }
+    CHECK(SolutionCache(path, "beam").size() == 3);
+    CHECK(SolutionCache(path, "beam").size() == 3);
+
+    auto read_file = [&] {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    auto write_file = [&](const std::string &bytes) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << bytes;
+    };
+    // drop the replacing record, and cut the one before it in its actions
+    {
+        auto bytes = read_file();
+        write_file(bytes.substr(0, bytes.size() - 96 - 1));
+    }
+    CHECK(SolutionCache(path, "beam").size() == 2);
+    CHECK(SolutionCache(path, "beam").size() == 2);
+
+    // a damaged record which is not the last one is refused, and the file left alone
+    {
+        auto bytes = read_file();
+        const std::size_t nb_actions_offset = 8 + 8 + deal_size;
+        bytes[nb_actions_offset + 1] = 0x7f;
+        write_file(bytes);
+        CHECK_THROWS_AS(SolutionCache(path, "beam"), std::runtime_error);
+        CHECK(read_file() == bytes);
+    }
+
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "not a cache";
+    }
+    CHECK_THROWS_AS(SolutionCache(path, "beam"), std::runtime_error);
+    std::remove(path.c_str());
+}
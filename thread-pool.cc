@@ -0,0 +1,63 @@
+#include "thread-pool.h"
+
+ThreadPool::ThreadPool(std::size_t nb_threads) {
+    for (std::size_t i = 1; i < nb_threads; ++i)
+        workers_.emplace_back(&ThreadPool::workerLoop_, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_ready_.notify_all();
+
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+void ThreadPool::runTasks_() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (next_task_ < nb_tasks_) {
+        std::size_t task_id = next_task_++;
+        lock.unlock();
+        (*task_)(task_id);
+        lock.lock();
+    }
+}
+
+void ThreadPool::workerLoop_() {
+    unsigned long seen_generation = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        work_ready_.wait(lock, [&]{return stop_ || generation_ != seen_generation;});
+        if (stop_)
+            return;
+
+        seen_generation = generation_;
+        nb_running_++;
+        lock.unlock();
+        runTasks_();
+        lock.lock();
+        if (--nb_running_ == 0)
+            work_done_.notify_all();
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t nb_tasks, const std::function<void(std::size_t)> &task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        nb_tasks_ = nb_tasks;
+        next_task_ = 0;
+        generation_++;
+    }
+    work_ready_.notify_all();
+
+    runTasks_();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_done_.wait(lock, [&]{return nb_running_ == 0;});
+    task_ = nullptr;
+}
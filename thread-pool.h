@@ -0,0 +1,45 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running parallel loops.
+// The calling thread takes part in the work, so a pool of size 1
+// has no extra thread and runs everything inline.
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t nb_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool& operator=(const ThreadPool &) = delete;
+
+    // calls task(0) ... task(nb_tasks-1), each exactly once, and
+    // returns when all of them are done
+    void parallelFor(std::size_t nb_tasks, const std::function<void(std::size_t)> &task);
+
+    std::size_t size() const {return workers_.size() + 1;}
+
+private:
+    void workerLoop_();
+    void runTasks_();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+
+    const std::function<void(std::size_t)> *task_ = nullptr;
+    std::size_t nb_tasks_ = 0;
+    std::size_t next_task_ = 0;
+    std::size_t nb_running_ = 0;
+    unsigned long generation_ = 0;
+    bool stop_ = false;
+};
+
+#endif